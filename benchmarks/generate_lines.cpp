@@ -0,0 +1,301 @@
+/*
+ *  © 2018 Geofabrik GmbH
+ *
+ *  This file is part of LinestringsSplitter.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/**
+ * Generator of synthetic line datasets for benchmarks.
+ *
+ * The output only depends on the options (including the seed), not on the platform.
+ */
+
+#include <getopt.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include <gdal/ogr_api.h>
+#include <gdal/ogrsf_frmts.h>
+
+#include "layer_writer.hpp"
+#include "random.hpp"
+
+namespace {
+
+    struct GeneratorOptions {
+        std::string output_filename;
+
+        std::string output_format = "ESRI Shapefile";
+
+        long count = 100000;
+
+        /// vertices per linestring, log-uniformly distributed between min and max
+        int min_vertices = 2;
+
+        int max_vertices = 1000;
+
+        /// mean distance between two vertices in metres
+        double spacing = 50;
+
+        /// number of attribute fields (string, integer and real fields in turn)
+        int fields = 4;
+
+        /// length of the values of string fields
+        int field_width = 16;
+
+        bool geographic = false;
+
+        /// percentage of multilinestrings with two to four members
+        int multi_percent = 0;
+
+        /// percentage of closed linestrings
+        int closed_percent = 0;
+
+        uint64_t seed = 1;
+    };
+
+    /// metres per degree at the equator
+    constexpr double METRES_PER_DEGREE = 111319.49;
+
+    constexpr double PI = 3.14159265358979323846;
+
+    void print_help(const char* progname) {
+        std::cerr << "Usage: " << progname << " [OPTIONS] OUTFILE\n" \
+                  << "Write a dataset of random linestrings for benchmarks.\n\n" \
+                  << "Options:\n" \
+                  << "  -h, --help           This help message\n" \
+                  << "  -f, --format FORMAT  Output format (default: ESRI Shapefile)\n" \
+                  << "  -n, --count N        Number of features (default: 100000)\n" \
+                  << "  --closed PERCENT     Percentage of closed linestrings (default: 0)\n" \
+                  << "  --fields N           Number of attribute fields, strings, integers and\n" \
+                  << "                       reals in turn (default: 4)\n" \
+                  << "  --field-width N      Length of the values of string fields (default: 16)\n" \
+                  << "  --geographic         Write EPSG:4326 instead of EPSG:3857 coordinates\n" \
+                  << "  --multi PERCENT      Percentage of multilinestrings (default: 0)\n" \
+                  << "  --seed N             Seed of the random numbers (default: 1)\n" \
+                  << "  --spacing METRES     Mean distance between vertices (default: 50)\n" \
+                  << "  --vertices MIN:MAX   Number of vertices per linestring, log-uniformly\n" \
+                  << "                       distributed (default: 2:1000)\n";
+    }
+
+    void parse_vertices(const char* arg, GeneratorOptions& options) {
+        char* end;
+        options.min_vertices = static_cast<int>(std::strtol(arg, &end, 10));
+        options.max_vertices = *end == ':' ? static_cast<int>(std::strtol(end + 1, &end, 10)) : options.min_vertices;
+        if (*end != '\0' || options.min_vertices < 2 || options.max_vertices < options.min_vertices) {
+            std::cerr << "ERROR: --vertices expects MIN:MAX with 2 ≤ MIN ≤ MAX\n";
+            exit(1);
+        }
+    }
+
+    /**
+     * Random walk starting at a random location of the extent of the dataset.
+     */
+    OGRLineString* make_linestring(const GeneratorOptions& options, Random& random) {
+        const double log_min = std::log(static_cast<double>(options.min_vertices));
+        const double log_max = std::log(static_cast<double>(options.max_vertices) + 1);
+        const int vertices = std::min(options.max_vertices,
+                static_cast<int>(std::exp(log_min + random.next() * (log_max - log_min))));
+        const bool closed = vertices > 3 && random.next() * 100 < options.closed_percent;
+        // The dataset covers 10° × 10° or 1000 km × 1000 km.
+        double x = options.geographic ? 5 + random.next() * 10 : random.next() * 1e6;
+        double y = options.geographic ? 45 + random.next() * 10 : random.next() * 1e6;
+        const double step = options.geographic ? options.spacing / METRES_PER_DEGREE : options.spacing;
+        double direction = random.next() * 2 * PI;
+        OGRLineString* linestring = new OGRLineString{};
+        linestring->setNumPoints(vertices);
+        for (int i = 0; i < vertices; ++i) {
+            linestring->setPoint(i, x, y);
+            // mostly straight, like roads and rivers
+            direction += (random.next() - 0.5) * 0.8;
+            const double length = step * (0.5 + random.next());
+            x += length * std::cos(direction);
+            y += length * std::sin(direction);
+        }
+        if (closed) {
+            linestring->setPoint(vertices - 1, linestring->getX(0), linestring->getY(0));
+        }
+        return linestring;
+    }
+
+    OGRGeometry* make_geometry(const GeneratorOptions& options, Random& random) {
+        if (random.next() * 100 >= options.multi_percent) {
+            return make_linestring(options, random);
+        }
+        OGRMultiLineString* multi = new OGRMultiLineString{};
+        const int members = random.next_int(2, 4);
+        for (int i = 0; i < members; ++i) {
+            multi->addGeometryDirectly(make_linestring(options, random));
+        }
+        return multi;
+    }
+
+    void set_fields(const GeneratorOptions& options, Random& random, OGRFeature* feature, std::string& buffer) {
+        for (int i = 0; i < options.fields; ++i) {
+            switch (i % 3) {
+            case 0:
+                buffer.clear();
+                for (int j = 0; j < options.field_width; ++j) {
+                    buffer += static_cast<char>('a' + random.next_int(0, 25));
+                }
+                feature->SetField(i, buffer.c_str());
+                break;
+            case 1:
+                feature->SetField(i, static_cast<GIntBig>(random.next() * 1e12));
+                break;
+            default:
+                feature->SetField(i, random.next() * 1000);
+                break;
+            }
+        }
+    }
+
+    void generate(const GeneratorOptions& options) {
+        gdal_dataset_type data_source = create_data_source(options.output_format, options.output_filename, nullptr, true);
+        OGRSpatialReference srs;
+        if (options.geographic) {
+            srs.SetWellKnownGeogCS("WGS84");
+        } else if (srs.importFromEPSG(3857) != OGRERR_NONE) {
+            std::cerr << "ERROR: failed to set up EPSG:3857\n";
+            exit(1);
+        }
+        OGRLayer* layer = data_source->CreateLayer("lines", &srs,
+                options.multi_percent > 0 ? wkbMultiLineString : wkbLineString);
+        if (layer == nullptr) {
+            std::cerr << "ERROR: failed to create layer in " << options.output_filename << '\n';
+            exit(1);
+        }
+        for (int i = 0; i < options.fields; ++i) {
+            const OGRFieldType type = i % 3 == 0 ? OFTString : (i % 3 == 1 ? OFTInteger64 : OFTReal);
+            OGRFieldDefn field_def {("field_" + std::to_string(i)).c_str(), type};
+            if (type == OFTString) {
+                field_def.SetWidth(options.field_width);
+            }
+            if (layer->CreateField(&field_def) != OGRERR_NONE) {
+                std::cerr << "ERROR: failed to create field " << field_def.GetNameRef() << '\n';
+                exit(1);
+            }
+        }
+        Random random {options.seed};
+        std::string buffer;
+        constexpr long transaction_size = 10000;
+        layer->StartTransaction();
+        for (long n = 0; n < options.count; ++n) {
+            OGRFeature* feature = OGRFeature::CreateFeature(layer->GetLayerDefn());
+            set_fields(options, random, feature, buffer);
+            OGRGeometry* geometry = make_geometry(options, random);
+            geometry->assignSpatialReference(&srs);
+            feature->SetGeometryDirectly(geometry);
+            if (layer->CreateFeature(feature) != OGRERR_NONE) {
+                std::cerr << "ERROR during writing a feature to " << options.output_filename << '\n';
+                exit(1);
+            }
+            OGRFeature::DestroyFeature(feature);
+            if ((n + 1) % transaction_size == 0) {
+                layer->CommitTransaction();
+                layer->StartTransaction();
+            }
+        }
+        layer->CommitTransaction();
+    }
+
+} // anonymous namespace
+
+int main(int argc, char* argv[]) {
+    constexpr int closed_option = 200;
+    constexpr int fields_option = 201;
+    constexpr int field_width_option = 202;
+    constexpr int geographic_option = 203;
+    constexpr int multi_option = 204;
+    constexpr int seed_option = 205;
+    constexpr int spacing_option = 206;
+    constexpr int vertices_option = 207;
+
+    static struct option long_options[] = {
+        {"help", no_argument, 0, 'h'},
+        {"format", required_argument, 0, 'f'},
+        {"count", required_argument, 0, 'n'},
+        {"closed", required_argument, 0, closed_option},
+        {"fields", required_argument, 0, fields_option},
+        {"field-width", required_argument, 0, field_width_option},
+        {"geographic", no_argument, 0, geographic_option},
+        {"multi", required_argument, 0, multi_option},
+        {"seed", required_argument, 0, seed_option},
+        {"spacing", required_argument, 0, spacing_option},
+        {"vertices", required_argument, 0, vertices_option},
+        {0, 0, 0, 0}
+    };
+    GeneratorOptions options;
+    while (true) {
+        int c = getopt_long(argc, argv, "hf:n:", long_options, 0);
+        if (c == -1) {
+            break;
+        }
+        switch (c) {
+        case 'h':
+            print_help(argv[0]);
+            exit(0);
+        case 'f':
+            options.output_format = optarg;
+            break;
+        case 'n':
+            options.count = std::atol(optarg);
+            break;
+        case closed_option:
+            options.closed_percent = std::atoi(optarg);
+            break;
+        case fields_option:
+            options.fields = std::atoi(optarg);
+            break;
+        case field_width_option:
+            options.field_width = std::atoi(optarg);
+            break;
+        case geographic_option:
+            options.geographic = true;
+            break;
+        case multi_option:
+            options.multi_percent = std::atoi(optarg);
+            break;
+        case seed_option:
+            options.seed = std::strtoull(optarg, nullptr, 10);
+            break;
+        case spacing_option:
+            options.spacing = std::atof(optarg);
+            break;
+        case vertices_option:
+            parse_vertices(optarg, options);
+            break;
+        default:
+            std::cerr << "ERROR: unknown command line option\n";
+            print_help(argv[0]);
+            exit(1);
+        }
+    }
+    if (argc - optind != 1) {
+        std::cerr << "ERROR: one positional argument required\n";
+        print_help(argv[0]);
+        exit(1);
+    }
+    options.output_filename = argv[optind];
+    GDALAllRegister();
+    generate(options);
+}
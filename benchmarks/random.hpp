@@ -0,0 +1,52 @@
+/*
+ *  © 2018 Geofabrik GmbH
+ *
+ *  This file is part of LinestringsSplitter.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef BENCHMARKS_RANDOM_HPP_
+#define BENCHMARKS_RANDOM_HPP_
+
+#include <cstdint>
+
+/**
+ * Deterministic pseudo-random numbers (xorshift64*), independent of the standard library,
+ * so generated data is identical on all platforms.
+ */
+class Random {
+    uint64_t m_state;
+
+public:
+    explicit Random(const uint64_t seed) noexcept :
+        m_state(seed == 0 ? 0x9e3779b97f4a7c15ULL : seed) {
+    }
+
+    /// uniformly distributed in [0, 1)
+    double next() noexcept {
+        m_state ^= m_state >> 12;
+        m_state ^= m_state << 25;
+        m_state ^= m_state >> 27;
+        return static_cast<double>((m_state * 0x2545f4914f6cdd1dULL) >> 11) / 9007199254740992.0;
+    }
+
+    /// uniformly distributed in [min, max]
+    int next_int(const int min, const int max) noexcept {
+        return min + static_cast<int>(next() * (max - min + 1));
+    }
+};
+
+#endif /* BENCHMARKS_RANDOM_HPP_ */
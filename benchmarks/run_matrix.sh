@@ -0,0 +1,105 @@
+#!/usr/bin/env bash
+#
+#  Run linestringssplitter on synthetic datasets across a matrix of settings and record wall
+#  time, CPU time and peak RSS as CSV. Runs entirely offline.
+#
+#  Usage: run_matrix.sh SPLITTER GENERATOR WORKDIR [RESULTS.csv]
+#
+#  The matrix can be changed with environment variables (lists are separated by commas):
+#
+#    COUNT              features per dataset (default: 200000)
+#    VERTICES           vertices per linestring, MIN:MAX (default: 2:2000)
+#    DATASETS           projected, geographic (default: both)
+#    FORMATS            output formats (default: ESRI Shapefile,GPKG,FlatGeobuf)
+#    TRANSACTION_SIZES  values of --gt (default: 1000,100000)
+#    SHARDS             values of --shards, i.e. writer threads (default: 1,4)
+#    MAX_LENGTH         value of -M (default: 2000)
+#    REPEAT             runs per combination (default: 1)
+#
+
+set -euo pipefail
+
+if [ $# -lt 3 ]; then
+    sed -n '3,20p' "$0" | sed 's/^# \{0,2\}//' >&2
+    exit 1
+fi
+
+SPLITTER=$1
+GENERATOR=$2
+WORKDIR=$3
+RESULTS=${4:-$WORKDIR/results.csv}
+
+COUNT=${COUNT:-200000}
+VERTICES=${VERTICES:-2:2000}
+DATASETS=${DATASETS:-projected,geographic}
+FORMATS=${FORMATS:-ESRI Shapefile,GPKG,FlatGeobuf}
+TRANSACTION_SIZES=${TRANSACTION_SIZES:-1000,100000}
+SHARDS=${SHARDS:-1,4}
+MAX_LENGTH=${MAX_LENGTH:-2000}
+REPEAT=${REPEAT:-1}
+
+extension() {
+    case "$1" in
+        "ESRI Shapefile") echo shp ;;
+        GPKG) echo gpkg ;;
+        FlatGeobuf) echo fgb ;;
+        GeoJSON) echo geojson ;;
+        WKBStream) echo wkb ;;
+        *) echo out ;;
+    esac
+}
+
+mkdir -p "$WORKDIR"
+
+IFS=',' read -r -a datasets <<< "$DATASETS"
+IFS=',' read -r -a formats <<< "$FORMATS"
+IFS=',' read -r -a transaction_sizes <<< "$TRANSACTION_SIZES"
+IFS=',' read -r -a shard_counts <<< "$SHARDS"
+
+for dataset in "${datasets[@]}"; do
+    input="$WORKDIR/input_${dataset}_${COUNT}.gpkg"
+    if [ ! -e "$input" ]; then
+        echo "Generating $input" >&2
+        geographic=()
+        if [ "$dataset" = geographic ]; then
+            geographic=(--geographic)
+        fi
+        "$GENERATOR" -f GPKG -n "$COUNT" --vertices "$VERTICES" ${geographic[@]+"${geographic[@]}"} "$input"
+    fi
+done
+
+echo "dataset,format,transaction_size,shards,run,wall_s,user_s,sys_s,peak_rss_bytes,features_in,parts_out" > "$RESULTS"
+
+# number from the --stats report of the last run
+value() {
+    sed -n "s/^ *\"$1\": \([0-9.]*\),\{0,1\}$/\1/p" "$WORKDIR/output/stats.json" | head -n 1
+}
+
+TIMEFORMAT='%R,%U,%S'
+for dataset in "${datasets[@]}"; do
+    input="$WORKDIR/input_${dataset}_${COUNT}.gpkg"
+    for format in "${formats[@]}"; do
+        for transaction_size in "${transaction_sizes[@]}"; do
+            for shards in "${shard_counts[@]}"; do
+                for run in $(seq "$REPEAT"); do
+                    rm -rf "$WORKDIR/output"
+                    mkdir "$WORKDIR/output"
+                    output="$WORKDIR/output/out.$(extension "$format")"
+                    stats="$WORKDIR/output/stats.json"
+                    echo "Running $dataset, $format, --gt $transaction_size, --shards $shards, run $run" >&2
+                    prefix="$dataset,$format,$transaction_size,$shards,$run"
+                    if times=$( { time "$SPLITTER" -f "$format" --gt "$transaction_size" --shards "$shards" \
+                            -M "$MAX_LENGTH" --stats "$stats" "$input" "$output" > /dev/null 2>&1 ; } 2>&1 ); then
+                        echo "$prefix,$times,$(value peak_rss),$(value features_in),$(value parts_out)" >> "$RESULTS"
+                    else
+                        echo "  failed" >&2
+                        echo "$prefix,failed,,,,," >> "$RESULTS"
+                    fi
+                done
+            done
+        done
+    done
+done
+rm -rf "$WORKDIR/output"
+
+echo "Results written to $RESULTS" >&2
@@ -0,0 +1,283 @@
+/*
+ *  © 2018 Geofabrik GmbH
+ *
+ *  This file is part of LinestringsSplitter.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/**
+ * Micro benchmarks of the split kernel, the distance functions, skip_ring() and the copying of
+ * attributes in LayerWriter::write_part().
+ *
+ * All inputs are generated in memory from a fixed seed, results are comparable across machines
+ * and commits. Parts are written as WKBStream to /dev/null (which costs little) unless the
+ * benchmark measures writing.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <gdal/ogr_api.h>
+#include <gdal/ogrsf_frmts.h>
+
+#include "layer_writer.hpp"
+#include "options.hpp"
+#include "output.hpp"
+#include "random.hpp"
+#include "splitter.hpp"
+
+/**
+ * Access to the private member functions of Output.
+ */
+struct OutputBenchmark {
+    static double distance(Output& output, const double x1, const double y1, const double x2, const double y2) {
+        return output.distance(x1, y1, x2, y2);
+    }
+
+    static void split_linestring(Output& output, OGRFeature* feature, OGRLineString* linestring) {
+        output.split_linestring(feature, linestring);
+    }
+
+    static bool skip_ring(Output& output, OGRLineString* linestring) {
+        return output.skip_ring(LineStringPoints{linestring});
+    }
+};
+
+namespace {
+
+    /**
+     * Random walk with the given number of vertices and steps of about the given length.
+     */
+    std::unique_ptr<OGRLineString> make_linestring(const int vertices, const double step, const bool closed,
+            const uint64_t seed) {
+        Random random {seed};
+        std::unique_ptr<OGRLineString> linestring {new OGRLineString{}};
+        linestring->setNumPoints(vertices);
+        double x = 0.0;
+        double y = 0.0;
+        for (int i = 0; i < vertices; ++i) {
+            linestring->setPoint(i, x, y);
+            const double angle = random.next() * 2 * 3.14159265358979323846;
+            const double length = step * (0.5 + random.next());
+            x += length * std::cos(angle);
+            y += length * std::sin(angle);
+        }
+        if (closed && vertices > 1) {
+            linestring->setPoint(vertices - 1, linestring->getX(0), linestring->getY(0));
+        }
+        return linestring;
+    }
+
+    /**
+     * Input layer in memory with the given number of attribute fields and one feature.
+     */
+    class Input {
+        OGRSpatialReference m_srs;
+
+        gdal_dataset_type m_dataset;
+
+        OGRLayer* m_layer;
+
+        OGRFeature* m_feature;
+
+    public:
+        Input(const bool geographic, const int fields) :
+            m_srs(),
+            m_dataset(create_data_source("Memory", "input", nullptr, false)),
+            m_layer(nullptr),
+            m_feature(nullptr) {
+            if (geographic) {
+                m_srs.SetWellKnownGeogCS("WGS84");
+            }
+            m_layer = m_dataset->CreateLayer("lines", &m_srs, wkbLineString);
+            // a mix of the most common field types
+            for (int i = 0; i < fields; ++i) {
+                const OGRFieldType type = i % 3 == 0 ? OFTString : (i % 3 == 1 ? OFTInteger64 : OFTReal);
+                OGRFieldDefn field_def {("field_" + std::to_string(i)).c_str(), type};
+                m_layer->CreateField(&field_def);
+            }
+            m_feature = OGRFeature::CreateFeature(m_layer->GetLayerDefn());
+            for (int i = 0; i < fields; ++i) {
+                if (i % 3 == 0) {
+                    m_feature->SetField(i, "some attribute value");
+                } else if (i % 3 == 1) {
+                    m_feature->SetField(i, static_cast<GIntBig>(1234567890123LL + i));
+                } else {
+                    m_feature->SetField(i, 0.5 * i);
+                }
+            }
+            m_feature->SetFID(42);
+        }
+
+        ~Input() {
+            OGRFeature::DestroyFeature(m_feature);
+        }
+
+        OGRLayer* layer() noexcept {
+            return m_layer;
+        }
+
+        OGRFeature* feature() noexcept {
+            return m_feature;
+        }
+    };
+
+    /**
+     * Options writing a WKB stream to /dev/null.
+     */
+    Options discarding_options(const bool geographic) {
+        Options options;
+        options.output_filename = "/dev/null";
+        options.output_format = WKB_STREAM_FORMAT;
+        options.geographic = geographic;
+        return options;
+    }
+
+    void BM_Distance(benchmark::State& state) {
+        const bool geographic = state.range(0) != 0;
+        Input input {geographic, 0};
+        Options options = discarding_options(geographic);
+        Output output {input.layer(), options};
+        std::unique_ptr<OGRLineString> linestring = make_linestring(1024, geographic ? 0.001 : 100.0, false, 1);
+        for (auto _ : state) {
+            double length = 0.0;
+            for (int i = 1; i < linestring->getNumPoints(); ++i) {
+                length += OutputBenchmark::distance(output, linestring->getX(i - 1), linestring->getY(i - 1),
+                        linestring->getX(i), linestring->getY(i));
+            }
+            benchmark::DoNotOptimize(length);
+        }
+        state.SetItemsProcessed(state.iterations() * (linestring->getNumPoints() - 1));
+    }
+    BENCHMARK(BM_Distance)->ArgName("geographic")->Arg(0)->Arg(1);
+
+    /**
+     * Arguments: number of vertices, max_length in percent of the length of the line, geographic mode.
+     */
+    void BM_SplitLinestring(benchmark::State& state) {
+        const int vertices = static_cast<int>(state.range(0));
+        const bool geographic = state.range(2) != 0;
+        // steps of about 100 m
+        const double step = geographic ? 0.0009 : 100.0;
+        Input input {geographic, 0};
+        Options options = discarding_options(geographic);
+        options.min_length = 0;
+        std::unique_ptr<OGRLineString> linestring = make_linestring(vertices, step, false, 2);
+        const double line_length = 100.0 * (vertices - 1);
+        options.max_length = line_length * static_cast<double>(state.range(1)) / 100.0;
+        Output output {input.layer(), options};
+        for (auto _ : state) {
+            OutputBenchmark::split_linestring(output, input.feature(), linestring.get());
+        }
+        state.SetItemsProcessed(state.iterations() * vertices);
+    }
+    BENCHMARK(BM_SplitLinestring)->ArgNames({"vertices", "max_length_pct", "geographic"})
+        ->ArgsProduct({{4, 64, 4096, 262144}, {1, 10, 200}, {0, 1}});
+
+    /**
+     * splitter::split() on interleaved coordinates, without GDAL and without writing the parts.
+     * Arguments: number of vertices, max_length in percent of the length of the line.
+     */
+    void BM_CoreSplit(benchmark::State& state) {
+        const int vertices = static_cast<int>(state.range(0));
+        std::unique_ptr<OGRLineString> linestring = make_linestring(vertices, 100.0, false, 2);
+        std::vector<double> xy;
+        for (int i = 0; i < vertices; ++i) {
+            xy.push_back(linestring->getX(i));
+            xy.push_back(linestring->getY(i));
+        }
+        const splitter::PointView points = splitter::PointView::interleaved(xy.data(), static_cast<size_t>(vertices));
+        const double max_length = 100.0 * (vertices - 1) * static_cast<double>(state.range(1)) / 100.0;
+        for (auto _ : state) {
+            size_t last = 0;
+            splitter::split(points, max_length, splitter::PlanarDistance{}, [&last](const splitter::Range& range) {
+                last = range.last;
+            });
+            benchmark::DoNotOptimize(last);
+        }
+        state.SetItemsProcessed(state.iterations() * vertices);
+    }
+    BENCHMARK(BM_CoreSplit)->ArgNames({"vertices", "max_length_pct"})->ArgsProduct({{4, 64, 4096, 262144}, {1, 10, 200}});
+
+    /**
+     * Arguments: number of vertices, closed ring.
+     */
+    void BM_SkipRing(benchmark::State& state) {
+        const int vertices = static_cast<int>(state.range(0));
+        Input input {false, 0};
+        Options options = discarding_options(false);
+        Output output {input.layer(), options};
+        std::unique_ptr<OGRLineString> linestring = make_linestring(vertices, 10.0, state.range(1) != 0, 3);
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(OutputBenchmark::skip_ring(output, linestring.get()));
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+    BENCHMARK(BM_SkipRing)->ArgNames({"vertices", "closed"})->ArgsProduct({{2, 5, 64, 4096}, {0, 1}});
+
+    /**
+     * Cost of LayerWriter::write_part() (attribute copying and CreateFeature) into a layer of the
+     * Memory driver. Argument: number of attribute fields.
+     */
+    void BM_WritePart(benchmark::State& state) {
+        constexpr int64_t features_per_layer = 65536;
+        const int fields = static_cast<int>(state.range(0));
+        Input input {false, fields};
+        Options options;
+        options.output_filename = "write_part";
+        options.output_format = "Memory";
+        options.transaction_size = 1 << 30;
+        std::unique_ptr<OGRLineString> linestring = make_linestring(16, 100.0, false, 4);
+        std::vector<double> x_coords;
+        std::vector<double> y_coords;
+        for (int i = 0; i < linestring->getNumPoints(); ++i) {
+            x_coords.push_back(linestring->getX(i));
+            y_coords.push_back(linestring->getY(i));
+        }
+        std::unique_ptr<LayerWriter> writer {new LayerWriter{options.output_filename, input.layer(), options}};
+        int64_t written = 0;
+        for (auto _ : state) {
+            writer->write_part(x_coords.data(), y_coords.data(), static_cast<int>(x_coords.size()), input.feature(),
+                    nullptr);
+            // start with an empty layer from time to time to keep the memory use bounded
+            if (++written % features_per_layer == 0) {
+                state.PauseTiming();
+                writer.reset(new LayerWriter{options.output_filename, input.layer(), options});
+                state.ResumeTiming();
+            }
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+    BENCHMARK(BM_WritePart)->ArgName("fields")->Arg(0)->Arg(4)->Arg(16)->Arg(64);
+
+} // anonymous namespace
+
+int main(int argc, char* argv[]) {
+    GDALAllRegister();
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
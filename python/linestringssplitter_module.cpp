@@ -0,0 +1,166 @@
+/*
+ *  © 2018 Geofabrik GmbH
+ *
+ *  This file is part of LinestringsSplitter.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/**
+ * Python module linestringssplitter: the splitting by length of splitter.hpp for batches of
+ * linestrings stored in NumPy arrays.
+ */
+
+#include <cstdint>
+#include <vector>
+
+#include <pybind11/numpy.h>
+#include <pybind11/pybind11.h>
+
+#include "splitter.hpp"
+
+namespace py = pybind11;
+
+namespace {
+
+    /// Contiguous float64 and int64 arrays are used as they are, other arrays are converted.
+    using coordinate_array = py::array_t<double, py::array::c_style | py::array::forcecast>;
+
+    using offset_array = py::array_t<int64_t, py::array::c_style | py::array::forcecast>;
+
+    /**
+     * Parts of a batch of linestrings: index of the linestring and range [start, end) of the
+     * vertices in the coordinate arrays.
+     */
+    struct Parts {
+        std::vector<int64_t> line;
+
+        std::vector<int64_t> start;
+
+        std::vector<int64_t> end;
+    };
+
+    /**
+     * Check the offsets of a batch of linestrings with point_count vertices in total.
+     *
+     * \returns number of linestrings
+     */
+    size_t check_offsets(const offset_array& offsets, const size_t point_count) {
+        if (offsets.ndim() != 1 || offsets.size() < 1) {
+            throw py::value_error("offsets must be a one-dimensional array with at least one element");
+        }
+        const int64_t* data = offsets.data();
+        const size_t line_count = static_cast<size_t>(offsets.size()) - 1;
+        if (data[0] < 0 || static_cast<uint64_t>(data[line_count]) > point_count) {
+            throw py::value_error("offsets must lie within the coordinate arrays");
+        }
+        for (size_t i = 0; i < line_count; ++i) {
+            if (data[i + 1] < data[i]) {
+                throw py::value_error("offsets must not decrease");
+            }
+        }
+        return line_count;
+    }
+
+    template <typename TDistance>
+    void split_batch(const splitter::PointView& points, const int64_t* offsets, const size_t line_count,
+            const double max_length, const double min_length, const TDistance& distance, Parts& parts) {
+        for (size_t i = 0; i < line_count; ++i) {
+            const size_t first = static_cast<size_t>(offsets[i]);
+            const splitter::PointView line = points.slice(first, static_cast<size_t>(offsets[i + 1]) - first);
+            double length;
+            if (splitter::skip_ring(line, min_length, distance, length)) {
+                continue;
+            }
+            splitter::split(line, max_length, distance, [&](const splitter::Range& range) {
+                parts.line.push_back(static_cast<int64_t>(i));
+                parts.start.push_back(static_cast<int64_t>(first + range.first));
+                parts.end.push_back(static_cast<int64_t>(first + range.last + 1));
+            });
+        }
+    }
+
+    /**
+     * Move a vector into a NumPy array which owns it, i.e. without copying its content.
+     */
+    py::array_t<int64_t> to_array(std::vector<int64_t>&& values) {
+        std::vector<int64_t>* owner = new std::vector<int64_t>{std::move(values)};
+        py::capsule free_owner {owner, [](void* pointer) {
+            delete static_cast<std::vector<int64_t>*>(pointer);
+        }};
+        return py::array_t<int64_t>{static_cast<py::ssize_t>(owner->size()), owner->data(), free_owner};
+    }
+
+    py::tuple split_points(const splitter::PointView& points, const offset_array& offsets, const double max_length,
+            const double min_length, const bool geographic) {
+        const size_t line_count = check_offsets(offsets, points.size());
+        const int64_t* offset_data = offsets.data();
+        Parts parts;
+        {
+            // The arrays are kept alive by the caller, they are not accessed through Python.
+            py::gil_scoped_release release;
+            if (geographic) {
+                split_batch(points, offset_data, line_count, max_length, min_length, splitter::SphericalDistance{}, parts);
+            } else {
+                split_batch(points, offset_data, line_count, max_length, min_length, splitter::PlanarDistance{}, parts);
+            }
+        }
+        return py::make_tuple(to_array(std::move(parts.line)), to_array(std::move(parts.start)),
+                to_array(std::move(parts.end)));
+    }
+
+    py::tuple split(const coordinate_array& x, const coordinate_array& y, const offset_array& offsets,
+            const double max_length, const double min_length, const bool geographic) {
+        if (x.ndim() != 1 || y.ndim() != 1 || x.size() != y.size()) {
+            throw py::value_error("x and y must be one-dimensional arrays of the same size");
+        }
+        const splitter::PointView points {x.data(), y.data(), static_cast<size_t>(x.size())};
+        return split_points(points, offsets, max_length, min_length, geographic);
+    }
+
+    py::tuple split_interleaved(const coordinate_array& xy, const offset_array& offsets, const double max_length,
+            const double min_length, const bool geographic) {
+        if (xy.ndim() != 2 || xy.shape(1) != 2) {
+            throw py::value_error("xy must be an array of shape (n, 2)");
+        }
+        const splitter::PointView points = splitter::PointView::interleaved(xy.data(), static_cast<size_t>(xy.shape(0)));
+        return split_points(points, offsets, max_length, min_length, geographic);
+    }
+
+    constexpr const char* SPLIT_DOC = R"(Split a batch of linestrings by length.
+
+Linestring i consists of the vertices offsets[i] to offsets[i + 1] - 1. Linestrings shorter than
+min_length are dropped unless they are closed rings with more than 5 vertices. The others are
+split at the first vertex where a part becomes longer than max_length, consecutive parts share
+this vertex. With geographic=True coordinates are longitude/latitude in degrees and lengths are
+in meters.
+
+The computation runs without holding the GIL. Contiguous float64 coordinates and int64 offsets
+are not copied.
+
+Returns a tuple (line, start, end) of int64 arrays with one entry per part: the index of the
+linestring and the range [start, end) of its vertices in the coordinate arrays.)";
+
+} // anonymous namespace
+
+PYBIND11_MODULE(linestringssplitter, m) {
+    m.doc() = "Split linestrings at existing vertices if they are longer than a threshold.";
+    m.def("split", &split, SPLIT_DOC, py::arg("x"), py::arg("y"), py::arg("offsets"),
+            py::arg("max_length") = 2000.0, py::arg("min_length") = 200.0, py::arg("geographic") = false);
+    m.def("split_interleaved", &split_interleaved,
+            "Same as split() with the coordinates as an array of shape (n, 2).", py::arg("xy"),
+            py::arg("offsets"), py::arg("max_length") = 2000.0, py::arg("min_length") = 200.0,
+            py::arg("geographic") = false);
+}
@@ -0,0 +1,189 @@
+/*
+ *  © 2018 Geofabrik GmbH
+ *
+ *  This file is part of LinestringsSplitter.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "attributes.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace attributes {
+
+    namespace {
+
+        void append_string(std::string& buffer, const char* str) {
+            const uint32_t length = static_cast<uint32_t>(std::strlen(str));
+            append<uint32_t>(buffer, length);
+            // keep the terminating null character, unpack() points into the buffer
+            buffer.append(str, length + 1);
+        }
+
+        const char* read_string(const char*& data) {
+            const uint32_t length = read<uint32_t>(data);
+            const char* str = data;
+            data += length + 1;
+            return str;
+        }
+
+        template <typename T>
+        void append_list(std::string& buffer, const int count, const T* list) {
+            append<uint32_t>(buffer, static_cast<uint32_t>(count));
+            buffer.append(reinterpret_cast<const char*>(list), sizeof(T) * static_cast<size_t>(count));
+        }
+
+        template <typename T>
+        std::vector<T> read_list(const char*& data) {
+            const uint32_t count = read<uint32_t>(data);
+            std::vector<T> list(count);
+            std::memcpy(list.data(), data, sizeof(T) * count);
+            data += sizeof(T) * count;
+            return list;
+        }
+
+    } // anonymous namespace
+
+    void pack(OGRFeature* feature, std::string& buffer) {
+        OGRFeatureDefn* defn = feature->GetDefnRef();
+        for (int i = 0; i < defn->GetFieldCount(); ++i) {
+            if (!feature->IsFieldSet(i)) {
+                append(buffer, FieldState::unset);
+                continue;
+            }
+#if GDAL_VERSION_NUM >= 2020000
+            if (feature->IsFieldNull(i)) {
+                append(buffer, FieldState::null);
+                continue;
+            }
+#endif
+            append(buffer, FieldState::set);
+            const OGRField* field = feature->GetRawFieldRef(i);
+            switch (defn->GetFieldDefn(i)->GetType()) {
+            case OFTInteger:
+                append(buffer, field->Integer);
+                break;
+            case OFTInteger64:
+                append(buffer, field->Integer64);
+                break;
+            case OFTReal:
+                append(buffer, field->Real);
+                break;
+            case OFTString:
+            case OFTWideString:
+                append_string(buffer, field->String);
+                break;
+            case OFTBinary:
+                append_list(buffer, field->Binary.nCount, field->Binary.paData);
+                break;
+            case OFTDate:
+            case OFTTime:
+            case OFTDateTime:
+                append(buffer, field->Date);
+                break;
+            case OFTIntegerList:
+                append_list(buffer, field->IntegerList.nCount, field->IntegerList.paList);
+                break;
+            case OFTInteger64List:
+                append_list(buffer, field->Integer64List.nCount, field->Integer64List.paList);
+                break;
+            case OFTRealList:
+                append_list(buffer, field->RealList.nCount, field->RealList.paList);
+                break;
+            case OFTStringList:
+            case OFTWideStringList:
+                append<uint32_t>(buffer, static_cast<uint32_t>(field->StringList.nCount));
+                for (int j = 0; j < field->StringList.nCount; ++j) {
+                    append_string(buffer, field->StringList.paList[j]);
+                }
+                break;
+            }
+        }
+    }
+
+    const char* unpack(const char* data, const int field_count, OGRFeature* feature) {
+        OGRFeatureDefn* defn = feature->GetDefnRef();
+        for (int i = 0; i < field_count; ++i) {
+            const FieldState state = read<FieldState>(data);
+            if (state == FieldState::unset) {
+                continue;
+            }
+#if GDAL_VERSION_NUM >= 2020000
+            if (state == FieldState::null) {
+                feature->SetFieldNull(i);
+                continue;
+            }
+#endif
+            OGRField field;
+            switch (defn->GetFieldDefn(i)->GetType()) {
+            case OFTInteger:
+                feature->SetField(i, read<int>(data));
+                break;
+            case OFTInteger64:
+                feature->SetField(i, read<GIntBig>(data));
+                break;
+            case OFTReal:
+                feature->SetField(i, read<double>(data));
+                break;
+            case OFTString:
+            case OFTWideString:
+                feature->SetField(i, read_string(data));
+                break;
+            case OFTBinary: {
+                    std::vector<GByte> binary = read_list<GByte>(data);
+                    feature->SetField(i, static_cast<int>(binary.size()), binary.data());
+                }
+                break;
+            case OFTDate:
+            case OFTTime:
+            case OFTDateTime:
+                field.Date = read<decltype(field.Date)>(data);
+                feature->SetField(i, &field);
+                break;
+            case OFTIntegerList: {
+                    std::vector<int> list = read_list<int>(data);
+                    feature->SetField(i, static_cast<int>(list.size()), list.data());
+                }
+                break;
+            case OFTInteger64List: {
+                    std::vector<GIntBig> list = read_list<GIntBig>(data);
+                    feature->SetField(i, static_cast<int>(list.size()), list.data());
+                }
+                break;
+            case OFTRealList: {
+                    std::vector<double> list = read_list<double>(data);
+                    feature->SetField(i, static_cast<int>(list.size()), list.data());
+                }
+                break;
+            case OFTStringList:
+            case OFTWideStringList: {
+                    const uint32_t count = read<uint32_t>(data);
+                    std::vector<char*> list;
+                    list.reserve(count + 1);
+                    for (uint32_t j = 0; j < count; ++j) {
+                        list.push_back(const_cast<char*>(read_string(data)));
+                    }
+                    list.push_back(nullptr);
+                    feature->SetField(i, list.data());
+                }
+                break;
+            }
+        }
+        return data;
+    }
+
+} // namespace attributes
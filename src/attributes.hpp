@@ -0,0 +1,75 @@
+/*
+ *  © 2018 Geofabrik GmbH
+ *
+ *  This file is part of LinestringsSplitter.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef ATTRIBUTES_HPP_
+#define ATTRIBUTES_HPP_
+
+#include <cstring>
+#include <string>
+
+#include <gdal/ogrsf_frmts.h>
+
+/**
+ * Packed binary encoding of the attributes of a feature.
+ *
+ * The types of the fields are not stored because both sides know the schema. Each field is
+ * encoded as a state byte (unset, null or set) followed by its value if it is set. Numbers
+ * are stored in native byte order, strings and binary fields are prefixed by their length
+ * (uint32_t), lists by their number of items (uint32_t).
+ */
+namespace attributes {
+
+    enum class FieldState : unsigned char {
+        unset = 0,
+        null = 1,
+        set = 2
+    };
+
+    template <typename T>
+    void append(std::string& buffer, const T value) {
+        buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template <typename T>
+    T read(const char*& data) {
+        T value;
+        std::memcpy(&value, data, sizeof(T));
+        data += sizeof(T);
+        return value;
+    }
+
+    /**
+     * Append the attributes of the feature to the buffer.
+     */
+    void pack(OGRFeature* feature, std::string& buffer);
+
+    /**
+     * Set the first fields of the feature from a packed attribute record.
+     *
+     * \param data pointer to the beginning of the packed record
+     * \param field_count number of fields in the packed record
+     *
+     * \returns pointer to the first byte after the record
+     */
+    const char* unpack(const char* data, const int field_count, OGRFeature* feature);
+
+} // namespace attributes
+
+#endif /* ATTRIBUTES_HPP_ */
@@ -0,0 +1,151 @@
+/*
+ *  © 2018 Geofabrik GmbH
+ *
+ *  This file is part of LinestringsSplitter.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "changeset_writer.hpp"
+
+#include <iostream>
+#include <memory>
+
+ChangeSetWriter::ChangeSetWriter(OGRLayer* input_layer, Options& options) :
+    m_options(options),
+    m_srs(nullptr),
+    m_data_source(),
+    m_layer(nullptr),
+    m_input_field_count(input_layer->GetLayerDefn()->GetFieldCount()) {
+    if (input_layer->GetSpatialRef()) {
+        m_srs = input_layer->GetSpatialRef()->Clone();
+    }
+    m_data_source = create_data_source(m_options.changes_format, m_options.changes_filename, nullptr, true);
+    m_layer = m_data_source->CreateLayer(input_layer->GetName(), m_srs, wkbLineString, nullptr);
+    if (m_layer == nullptr) {
+        std::cerr << "ERROR: failed to create layer in " << m_options.changes_filename << '\n';
+        exit(1);
+    }
+    OGRFeatureDefn* input_feature_def = input_layer->GetLayerDefn();
+    for (int i = 0; i < m_input_field_count; ++i) {
+        OGRFieldDefn* field_def = input_feature_def->GetFieldDefn(i);
+        if (m_layer->CreateField(field_def, TRUE) != OGRERR_NONE) {
+            std::cerr << "Creating field " << field_def->GetNameRef() << " failed\n";
+            exit(1);
+        }
+    }
+    int next_field = m_input_field_count;
+    if (m_options.grid_size > 0) {
+        create_field("cell_x", OFTInteger);
+        create_field("cell_y", OFTInteger);
+        m_cell_x_field = next_field++;
+        m_cell_y_field = next_field++;
+    }
+    create_field("op", OFTString);
+    create_field("src_fid", OFTInteger64);
+    create_field("part_index", OFTInteger);
+    create_field("out_fid", OFTInteger64);
+    m_op_field = next_field++;
+    m_src_fid_field = next_field++;
+    m_part_index_field = next_field++;
+    m_out_fid_field = next_field;
+    if (m_layer->StartTransaction() != OGRERR_NONE) {
+        std::cerr << "Failed to start transaction in change set layer.\n";
+        exit(1);
+    }
+}
+
+ChangeSetWriter::~ChangeSetWriter() {
+#if GDAL_VERSION_MAJOR < 2
+    OGRDataSource::DestroyDataSource(m_data_source);
+#endif
+    if (m_srs) {
+        m_srs->Release();
+    }
+}
+
+void ChangeSetWriter::create_field(const char* name, const OGRFieldType type) {
+    OGRFieldDefn field_def {name, type};
+    if (m_layer->CreateField(&field_def, TRUE) != OGRERR_NONE) {
+        std::cerr << "Creating field " << name << " in change set failed\n";
+        exit(1);
+    }
+}
+
+OGRFeature* ChangeSetWriter::create_feature(const char* op, const GIntBig src_fid, const size_t part_index,
+        const GIntBig out_fid) {
+    OGRFeature* feature = OGRFeature::CreateFeature(m_layer->GetLayerDefn());
+    feature->SetField(m_op_field, op);
+    feature->SetField(m_src_fid_field, src_fid);
+    feature->SetField(m_part_index_field, static_cast<int>(part_index));
+    feature->SetField(m_out_fid_field, out_fid);
+    return feature;
+}
+
+void ChangeSetWriter::write_feature(OGRFeature* feature) {
+    if (m_layer->CreateFeature(feature) != OGRERR_NONE) {
+        std::cerr << "ERROR during writing a feature to the change set\n";
+        exit(1);
+    }
+    OGRFeature::DestroyFeature(feature);
+    ++m_transaction_count;
+    if (m_transaction_count > m_options.transaction_size) {
+        if (m_layer->CommitTransaction() != OGRERR_NONE || m_layer->StartTransaction() != OGRERR_NONE) {
+            std::cerr << "Failed to start a new transaction in change set layer.\n";
+            exit(1);
+        }
+        m_transaction_count = 0;
+    }
+}
+
+void ChangeSetWriter::write_insert(const double* x_coords, const double* y_coords, const int count, OGRFeature* feature,
+        const GridCell* cell, const size_t part_index, const GIntBig out_fid) {
+    OGRFeature* change = create_feature("insert", feature->GetFID(), part_index, out_fid);
+    for (int i = 0; i < m_input_field_count; ++i) {
+        change->SetField(i, feature->GetRawFieldRef(i));
+    }
+    if (cell) {
+        change->SetField(m_cell_x_field, cell->x);
+        change->SetField(m_cell_y_field, cell->y);
+    }
+    std::unique_ptr<OGRLineString> geometry {static_cast<OGRLineString*>(OGRGeometryFactory::createGeometry(wkbLineString))};
+    geometry->assignSpatialReference(m_srs);
+    geometry->setPoints(count, x_coords, y_coords);
+    change->SetGeometryDirectly(geometry.release());
+    write_feature(change);
+}
+
+void ChangeSetWriter::write_delete(const GIntBig src_fid, const size_t part_index, const GIntBig out_fid) {
+    write_feature(create_feature("delete", src_fid, part_index, out_fid));
+}
+
+void ChangeSetWriter::write_unchanged(const GIntBig src_fid, const size_t part_index, const GIntBig out_fid) {
+    write_feature(create_feature("unchanged", src_fid, part_index, out_fid));
+}
+
+void ChangeSetWriter::finalize() {
+    if (m_layer->CommitTransaction() != OGRERR_NONE) {
+        std::cerr << "Failed to commit transaction in change set layer.\n";
+        exit(1);
+    }
+    m_layer->SyncToDisk();
+    m_layer = nullptr;
+#if GDAL_VERSION_MAJOR >= 2
+    m_data_source.reset();
+#else
+    OGRDataSource::DestroyDataSource(m_data_source);
+    m_data_source = nullptr;
+#endif
+}
@@ -0,0 +1,94 @@
+/*
+ *  © 2018 Geofabrik GmbH
+ *
+ *  This file is part of LinestringsSplitter.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef CHANGESET_WRITER_HPP_
+#define CHANGESET_WRITER_HPP_
+
+#include <string>
+
+#include <gdal/ogr_api.h>
+#include <gdal/ogrsf_frmts.h>
+
+#include "layer_writer.hpp"
+#include "options.hpp"
+
+/**
+ * Writer of the change set of an incremental run.
+ *
+ * The change set is an OGR layer with the schema of the output and the additional fields op
+ * (insert, delete or unchanged), src_fid, part_index and out_fid. The pair (src_fid, part_index)
+ * identifies a part independently of its FID in the output: parts are numbered in the order
+ * they are produced by splitting the input feature, which is deterministic. Only inserted
+ * parts carry their geometry and attributes.
+ */
+class ChangeSetWriter {
+private:
+    Options& m_options;
+
+    OGRSpatialReference* m_srs;
+
+    gdal_dataset_type m_data_source;
+
+    OGRLayer* m_layer;
+
+    int m_input_field_count;
+
+    int m_cell_x_field = -1;
+
+    int m_cell_y_field = -1;
+
+    int m_op_field;
+
+    int m_src_fid_field;
+
+    int m_part_index_field;
+
+    int m_out_fid_field;
+
+    int m_transaction_count = 0;
+
+    void create_field(const char* name, const OGRFieldType type);
+
+    OGRFeature* create_feature(const char* op, const GIntBig src_fid, const size_t part_index, const GIntBig out_fid);
+
+    void write_feature(OGRFeature* feature);
+
+public:
+    ChangeSetWriter(OGRLayer* input_layer, Options& options);
+
+    ChangeSetWriter() = delete;
+
+    ChangeSetWriter(const ChangeSetWriter&) = delete;
+
+    ChangeSetWriter& operator=(const ChangeSetWriter&) = delete;
+
+    ~ChangeSetWriter();
+
+    void write_insert(const double* x_coords, const double* y_coords, const int count, OGRFeature* feature,
+            const GridCell* cell, const size_t part_index, const GIntBig out_fid);
+
+    void write_delete(const GIntBig src_fid, const size_t part_index, const GIntBig out_fid);
+
+    void write_unchanged(const GIntBig src_fid, const size_t part_index, const GIntBig out_fid);
+
+    void finalize();
+};
+
+#endif /* CHANGESET_WRITER_HPP_ */
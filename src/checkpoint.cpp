@@ -0,0 +1,86 @@
+/*
+ *  © 2018 Geofabrik GmbH
+ *
+ *  This file is part of LinestringsSplitter.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "checkpoint.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include <unistd.h>
+
+bool Checkpoint::load(const std::string& filename) {
+    std::ifstream file {filename};
+    if (!file) {
+        return false;
+    }
+    int found = 0;
+    std::string line;
+    while (std::getline(file, line)) {
+        const size_t equals = line.find('=');
+        if (equals == std::string::npos) {
+            continue;
+        }
+        const std::string key = line.substr(0, equals);
+        const char* value_str = line.c_str() + equals + 1;
+        char* end;
+        errno = 0;
+        const GIntBig value = std::strtoll(value_str, &end, 10);
+        if (end == value_str || *end != '\0' || errno == ERANGE) {
+            // truncated or edited by hand
+            return false;
+        }
+        if (key == "input_offset") {
+            input_offset = value;
+            ++found;
+        } else if (key == "last_input_fid") {
+            last_input_fid = value;
+            ++found;
+        } else if (key == "output_features") {
+            output_features = value;
+            ++found;
+        }
+    }
+    return found == 3;
+}
+
+void Checkpoint::save(const std::string& filename) const {
+    const std::string temp_filename = filename + ".tmp";
+    std::FILE* file = std::fopen(temp_filename.c_str(), "w");
+    if (!file) {
+        std::cerr << "ERROR: failed to open " << temp_filename << ": " << std::strerror(errno) << '\n';
+        exit(1);
+    }
+    std::fprintf(file, "input_offset=%lld\nlast_input_fid=%lld\noutput_features=%lld\n",
+            static_cast<long long>(input_offset), static_cast<long long>(last_input_fid),
+            static_cast<long long>(output_features));
+    // The data has to reach the disk before the rename, a crash could leave an empty checkpoint otherwise.
+    if (std::fflush(file) != 0 || fsync(fileno(file)) != 0) {
+        std::cerr << "ERROR: writing checkpoint " << temp_filename << " failed: " << std::strerror(errno) << '\n';
+        exit(1);
+    }
+    if (std::fclose(file) != 0 || std::rename(temp_filename.c_str(), filename.c_str()) != 0) {
+        std::cerr << "ERROR: writing checkpoint " << filename << " failed: " << std::strerror(errno) << '\n';
+        exit(1);
+    }
+}
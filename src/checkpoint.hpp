@@ -0,0 +1,54 @@
+/*
+ *  © 2018 Geofabrik GmbH
+ *
+ *  This file is part of LinestringsSplitter.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef CHECKPOINT_HPP_
+#define CHECKPOINT_HPP_
+
+#include <string>
+
+#include <gdal/ogr_api.h>
+
+/**
+ * State of a run at the time of the last commit of the output, used to resume an interrupted run.
+ *
+ * The checkpoint is a small text file with one KEY=VALUE pair per line.
+ */
+struct Checkpoint {
+    /// number of input features which have been processed completely
+    GIntBig input_offset = 0;
+
+    /// FID of the last input feature which has been processed completely
+    GIntBig last_input_fid = OGRNullFID;
+
+    /// number of features in the output layer
+    GIntBig output_features = 0;
+
+    /**
+     * Read the checkpoint. Returns false if the file does not exist, is incomplete or malformed.
+     */
+    bool load(const std::string& filename);
+
+    /**
+     * Write the checkpoint atomically (write a temporary file and rename it).
+     */
+    void save(const std::string& filename) const;
+};
+
+#endif /* CHECKPOINT_HPP_ */
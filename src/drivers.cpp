@@ -0,0 +1,148 @@
+/*
+ *  © 2018 Geofabrik GmbH
+ *
+ *  This file is part of LinestringsSplitter.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "drivers.hpp"
+
+#include <cstring>
+#include <strings.h>
+
+#include <dlfcn.h>
+
+#include <gdal/ogrsf_frmts.h>
+
+namespace drivers {
+
+    namespace {
+
+        struct DriverInfo {
+            const char* name;
+
+            /// name of the function registering the driver, exported by the GDAL library
+            const char* register_function;
+
+            /// file name extensions (including the dot) or prefixes of connection strings
+            std::vector<std::string> extensions;
+
+            std::vector<std::string> prefixes;
+        };
+
+        /**
+         * Drivers which can be registered alone. Drivers opening datasets of other formats
+         * (e.g. VRT) are missing on purpose.
+         */
+        const std::vector<DriverInfo>& known_drivers() {
+            static const std::vector<DriverInfo> table {
+                {"ESRI Shapefile", "RegisterOGRShape", {".shp", ".dbf"}, {}},
+                {"SQLite", "RegisterOGRSQLite", {".sqlite", ".db"}, {}},
+                {"GPKG", "RegisterOGRGeoPackage", {".gpkg"}, {}},
+                {"GeoJSON", "RegisterOGRGeoJSON", {".geojson", ".json"}, {}},
+                {"GeoJSONSeq", "RegisterOGRGeoJSONSeq", {".geojsonl", ".geojsons"}, {}},
+                {"FlatGeobuf", "RegisterOGRFlatGeobuf", {".fgb"}, {}},
+                {"CSV", "RegisterOGRCSV", {".csv"}, {}},
+                {"GML", "RegisterOGRGML", {".gml"}, {}},
+                {"GPX", "RegisterOGRGPX", {".gpx"}, {}},
+                {"MapInfo File", "RegisterOGRTAB", {".tab", ".mif"}, {}},
+                {"OSM", "RegisterOGROSM", {".pbf", ".osm"}, {}},
+                {"PostgreSQL", "RegisterOGRPG", {}, {"PG:"}},
+                {"Memory", "RegisterOGRMEM", {}, {}}
+            };
+            return table;
+        }
+
+        bool ends_with_nocase(const std::string& str, const std::string& suffix) {
+            return str.size() >= suffix.size()
+                && !strcasecmp(str.c_str() + str.size() - suffix.size(), suffix.c_str());
+        }
+
+        bool all_drivers = false;
+
+    } // anonymous namespace
+
+    void register_all() {
+        if (all_drivers) {
+            return;
+        }
+#if GDAL_VERSION_MAJOR >= 2
+        GDALAllRegister();
+#else
+        OGRRegisterAll();
+#endif
+        all_drivers = true;
+    }
+
+    std::string driver_for(const std::string& dataset_name) {
+        for (const DriverInfo& driver : known_drivers()) {
+            for (const std::string& prefix : driver.prefixes) {
+                if (!strncasecmp(dataset_name.c_str(), prefix.c_str(), prefix.size())) {
+                    return driver.name;
+                }
+            }
+            for (const std::string& extension : driver.extensions) {
+                if (ends_with_nocase(dataset_name, extension)) {
+                    return driver.name;
+                }
+            }
+        }
+        return "";
+    }
+
+    bool register_only(const std::vector<std::string>& driver_names) {
+        if (all_drivers) {
+            return true;
+        }
+        // Look up all functions first to register nothing if one is missing.
+        std::vector<void (*)()> functions;
+        for (const std::string& name : driver_names) {
+            const DriverInfo* info = nullptr;
+            for (const DriverInfo& driver : known_drivers()) {
+                if (!strcasecmp(driver.name, name.c_str())) {
+                    info = &driver;
+                    break;
+                }
+            }
+            if (!info) {
+                return false;
+            }
+            void* function = dlsym(RTLD_DEFAULT, info->register_function);
+            if (!function) {
+                return false;
+            }
+            functions.push_back(reinterpret_cast<void (*)()>(function));
+        }
+        // The functions do nothing if their driver is registered already.
+        for (const auto function : functions) {
+            function();
+        }
+        return true;
+    }
+
+    int count() {
+#if GDAL_VERSION_MAJOR >= 2
+        return GetGDALDriverManager()->GetDriverCount();
+#else
+        return OGRSFDriverRegistrar::GetRegistrar()->GetDriverCount();
+#endif
+    }
+
+    bool all_registered() noexcept {
+        return all_drivers;
+    }
+
+} // namespace drivers
@@ -0,0 +1,66 @@
+/*
+ *  © 2018 Geofabrik GmbH
+ *
+ *  This file is part of LinestringsSplitter.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef DRIVERS_HPP_
+#define DRIVERS_HPP_
+
+#include <string>
+#include <vector>
+
+/**
+ * Registration of the GDAL/OGR drivers.
+ *
+ * Registering all drivers (GDALAllRegister) loads 200+ drivers and plugins, which dominates the
+ * start-up time of short runs. Usually only the drivers of the input and the output format are
+ * needed, they can be registered alone.
+ */
+namespace drivers {
+
+    /**
+     * Register all drivers, only once per process.
+     */
+    void register_all();
+
+    /**
+     * Name of the driver for a dataset by the extension or prefix of its name.
+     *
+     * \returns driver name or an empty string if the format is not known
+     */
+    std::string driver_for(const std::string& dataset_name);
+
+    /**
+     * Register the given drivers only.
+     *
+     * Unknown drivers and drivers not built into GDAL (e.g. built as plugins) cannot be registered
+     * alone, the caller has to fall back to register_all() then.
+     *
+     * \returns true if all drivers are registered
+     */
+    bool register_only(const std::vector<std::string>& driver_names);
+
+    /// Number of registered drivers.
+    int count();
+
+    /// True if register_all() has been called.
+    bool all_registered() noexcept;
+
+} // namespace drivers
+
+#endif /* DRIVERS_HPP_ */
@@ -0,0 +1,191 @@
+/*
+ *  © 2018 Geofabrik GmbH
+ *
+ *  This file is part of LinestringsSplitter.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "external_sorter.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <queue>
+
+#include <unistd.h>
+
+#include "memory.hpp"
+#include "trace.hpp"
+
+namespace {
+
+    void write_or_fail(const void* data, const size_t size, FILE* file) {
+        if (size > 0 && std::fwrite(data, size, 1, file) != 1) {
+            std::cerr << "ERROR: writing temporary file failed: " << std::strerror(errno) << '\n';
+            exit(1);
+        }
+    }
+
+    void write_record(const uint64_t key, const std::string& record, FILE* file) {
+        const uint32_t size = static_cast<uint32_t>(record.size());
+        write_or_fail(&key, sizeof(key), file);
+        write_or_fail(&size, sizeof(size), file);
+        write_or_fail(record.data(), record.size(), file);
+    }
+
+    /**
+     * Read the next record from a run. Returns false at the end of the run.
+     */
+    bool read_record(FILE* file, uint64_t& key, std::string& record) {
+        uint32_t size;
+        if (std::fread(&key, sizeof(key), 1, file) != 1) {
+            return false;
+        }
+        if (std::fread(&size, sizeof(size), 1, file) != 1) {
+            std::cerr << "ERROR: temporary file is truncated\n";
+            exit(1);
+        }
+        record.resize(size);
+        if (size > 0 && std::fread(&record[0], size, 1, file) != 1) {
+            std::cerr << "ERROR: temporary file is truncated\n";
+            exit(1);
+        }
+        return true;
+    }
+
+} // anonymous namespace
+
+ExternalSorter::ExternalSorter(const size_t memory_limit, const std::string& temp_directory) :
+    m_memory_limit(memory_limit),
+    m_temp_directory(temp_directory),
+    m_records(),
+    m_runs() {
+}
+
+ExternalSorter::~ExternalSorter() {
+    for (FILE* run : m_runs) {
+        std::fclose(run);
+    }
+}
+
+FILE* ExternalSorter::create_temp_file() {
+    std::string path = m_temp_directory + "/linestringssplitter-XXXXXX";
+    int fd = mkstemp(&path[0]);
+    if (fd == -1) {
+        std::cerr << "ERROR: failed to create temporary file in " << m_temp_directory << ": " << std::strerror(errno) << '\n';
+        exit(1);
+    }
+    // The file is deleted as soon as it gets closed.
+    unlink(path.c_str());
+    FILE* file = fdopen(fd, "w+b");
+    if (!file) {
+        std::cerr << "ERROR: failed to open temporary file: " << std::strerror(errno) << '\n';
+        exit(1);
+    }
+    return file;
+}
+
+void ExternalSorter::sort_records() {
+    std::stable_sort(m_records.begin(), m_records.end(), [](const record_type& a, const record_type& b) {
+        return a.first < b.first;
+    });
+}
+
+void ExternalSorter::write_run() {
+    trace::Span span {"write sorted run"};
+    span.set_arg("parts", static_cast<int64_t>(m_records.size()));
+    sort_records();
+    FILE* run = create_temp_file();
+    for (const record_type& record : m_records) {
+        write_record(record.first, record.second, run);
+    }
+    m_runs.push_back(run);
+    ++m_run_count;
+    m_records = std::vector<record_type>();
+    memory::sorter.sub(m_memory_used);
+    m_memory_used = 0;
+}
+
+void ExternalSorter::add(const uint64_t key, std::string&& record) {
+    m_memory_used += record.size() + RECORD_OVERHEAD;
+    memory::sorter.add(record.size() + RECORD_OVERHEAD);
+    m_records.emplace_back(key, std::move(record));
+    ++m_record_count;
+    if (m_memory_used > m_memory_limit) {
+        write_run();
+    }
+}
+
+void ExternalSorter::merge(std::vector<FILE*>& runs, FILE* output, const callback_type& callback) {
+    // Entries of the queue are (key, run index). The run index keeps records with identical
+    // keys in the order the runs have been written.
+    using entry_type = std::pair<uint64_t, size_t>;
+    std::priority_queue<entry_type, std::vector<entry_type>, std::greater<entry_type>> queue;
+    std::vector<std::string> current(runs.size());
+    for (size_t i = 0; i < runs.size(); ++i) {
+        std::rewind(runs[i]);
+        uint64_t key;
+        if (read_record(runs[i], key, current[i])) {
+            queue.emplace(key, i);
+        }
+    }
+    while (!queue.empty()) {
+        const entry_type top = queue.top();
+        queue.pop();
+        if (output) {
+            write_record(top.first, current[top.second], output);
+        } else {
+            callback(current[top.second]);
+        }
+        uint64_t key;
+        if (read_record(runs[top.second], key, current[top.second])) {
+            queue.emplace(key, top.second);
+        }
+    }
+    for (FILE* run : runs) {
+        std::fclose(run);
+    }
+    runs.clear();
+}
+
+void ExternalSorter::read_sorted(const callback_type& callback) {
+    if (m_runs.empty()) {
+        // everything fits into memory
+        sort_records();
+        for (const record_type& record : m_records) {
+            callback(record.second);
+        }
+        m_records = std::vector<record_type>();
+        memory::sorter.sub(m_memory_used);
+        m_memory_used = 0;
+        return;
+    }
+    if (!m_records.empty()) {
+        write_run();
+    }
+    // Reduce the number of runs until they can be merged at once.
+    while (m_runs.size() > MAX_MERGE_WIDTH) {
+        std::vector<FILE*> runs {m_runs.begin(), m_runs.begin() + MAX_MERGE_WIDTH};
+        m_runs.erase(m_runs.begin(), m_runs.begin() + MAX_MERGE_WIDTH);
+        FILE* merged = create_temp_file();
+        merge(runs, merged, callback);
+        // the merged run holds the oldest records
+        m_runs.insert(m_runs.begin(), merged);
+    }
+    merge(m_runs, nullptr, callback);
+}
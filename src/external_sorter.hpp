@@ -0,0 +1,105 @@
+/*
+ *  © 2018 Geofabrik GmbH
+ *
+ *  This file is part of LinestringsSplitter.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef EXTERNAL_SORTER_HPP_
+#define EXTERNAL_SORTER_HPP_
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Sort records by a 64 bit key using a limited amount of memory.
+ *
+ * Records are collected in memory. If their size exceeds the memory budget, they are sorted
+ * and written as a sorted run to a temporary file. Runs are merged when the records are read.
+ * Records with the same key keep the order they have been added in.
+ */
+class ExternalSorter {
+public:
+    using callback_type = std::function<void(const std::string&)>;
+
+private:
+    using record_type = std::pair<uint64_t, std::string>;
+
+    /// maximum number of runs merged at once
+    static constexpr size_t MAX_MERGE_WIDTH = 128;
+
+    /// approximate memory overhead of a record in addition to its payload
+    static constexpr size_t RECORD_OVERHEAD = sizeof(record_type) + 16;
+
+    size_t m_memory_limit;
+
+    size_t m_memory_used = 0;
+
+    std::string m_temp_directory;
+
+    std::vector<record_type> m_records;
+
+    std::vector<FILE*> m_runs;
+
+    size_t m_record_count = 0;
+
+    /// number of runs written, not reduced by merging
+    size_t m_run_count = 0;
+
+    FILE* create_temp_file();
+
+    void sort_records();
+
+    void write_run();
+
+    /**
+     * Merge runs and either write the result to a file or hand every record to the callback.
+     */
+    void merge(std::vector<FILE*>& runs, FILE* output, const callback_type& callback);
+
+public:
+    /**
+     * \param memory_limit memory budget in bytes
+     * \param temp_directory directory for temporary files holding the sorted runs
+     */
+    ExternalSorter(const size_t memory_limit, const std::string& temp_directory);
+
+    ~ExternalSorter();
+
+    void add(const uint64_t key, std::string&& record);
+
+    /**
+     * Call the callback for every record in the order of their keys.
+     */
+    void read_sorted(const callback_type& callback);
+
+    size_t record_count() const noexcept {
+        return m_record_count;
+    }
+
+    /**
+     * Number of sorted runs written to temporary files (0 if everything fit into memory).
+     */
+    size_t run_count() const noexcept {
+        return m_run_count;
+    }
+};
+
+#endif /* EXTERNAL_SORTER_HPP_ */
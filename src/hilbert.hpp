@@ -0,0 +1,58 @@
+/*
+ *  © 2018 Geofabrik GmbH
+ *
+ *  This file is part of LinestringsSplitter.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef HILBERT_HPP_
+#define HILBERT_HPP_
+
+#include <cstdint>
+
+/**
+ * Number of bits per axis of the Hilbert curve, i.e. the curve covers a grid of 2^16 × 2^16 cells.
+ */
+constexpr int HILBERT_ORDER = 16;
+
+/**
+ * Calculate the position of a cell on the Hilbert curve.
+ *
+ * \param x column of the cell (0 ≤ x < 2^HILBERT_ORDER)
+ * \param y row of the cell (0 ≤ y < 2^HILBERT_ORDER)
+ */
+inline uint64_t hilbert_index(uint32_t x, uint32_t y) noexcept {
+    constexpr uint32_t n = 1u << HILBERT_ORDER;
+    uint64_t index = 0;
+    for (uint32_t s = n / 2; s > 0; s >>= 1) {
+        const uint32_t rx = (x & s) > 0 ? 1 : 0;
+        const uint32_t ry = (y & s) > 0 ? 1 : 0;
+        index += static_cast<uint64_t>(s) * s * ((3 * rx) ^ ry);
+        // rotate the quadrant
+        if (ry == 0) {
+            if (rx == 1) {
+                x = n - 1 - x;
+                y = n - 1 - y;
+            }
+            const uint32_t t = x;
+            x = y;
+            y = t;
+        }
+    }
+    return index;
+}
+
+#endif /* HILBERT_HPP_ */
@@ -0,0 +1,162 @@
+/*
+ *  © 2018 Geofabrik GmbH
+ *
+ *  This file is part of LinestringsSplitter.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "incremental_index.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+    template <typename T>
+    bool read_value(std::FILE* file, T& value) {
+        return std::fread(&value, sizeof(T), 1, file) == 1;
+    }
+
+    template <typename T>
+    void write_value(std::FILE* file, const T& value, const std::string& filename) {
+        if (std::fwrite(&value, sizeof(T), 1, file) != 1) {
+            std::cerr << "ERROR: writing " << filename << " failed: " << std::strerror(errno) << '\n';
+            exit(1);
+        }
+    }
+
+} // anonymous namespace
+
+IncrementalIndex::IncrementalIndex(const std::string& filename, const uint64_t fingerprint) :
+    m_filename(filename),
+    m_fingerprint(fingerprint),
+    m_entries() {
+}
+
+bool IncrementalIndex::load() {
+    std::FILE* file = std::fopen(m_filename.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    char magic[8];
+    uint32_t version;
+    uint64_t fingerprint;
+    uint64_t count;
+    if (std::fread(magic, sizeof(magic), 1, file) != 1 || std::memcmp(magic, "LSSINDEX", sizeof(magic))
+            || !read_value(file, version) || version != VERSION
+            || !read_value(file, fingerprint) || !read_value(file, count)) {
+        std::cerr << "WARNING: " << m_filename << " is not a valid index, rebuilding the output.\n";
+        std::fclose(file);
+        return false;
+    }
+    if (fingerprint != m_fingerprint) {
+        std::cerr << "WARNING: options or input schema changed since " << m_filename
+            << " was written, rebuilding the output.\n";
+        std::fclose(file);
+        return false;
+    }
+    m_entries.reserve(count);
+    for (uint64_t i = 0; i < count; ++i) {
+        GIntBig fid;
+        Entry entry;
+        uint32_t part_count;
+        if (!read_value(file, fid) || !read_value(file, entry.hash) || !read_value(file, part_count)) {
+            std::cerr << "WARNING: " << m_filename << " is truncated, rebuilding the output.\n";
+            m_entries.clear();
+            std::fclose(file);
+            return false;
+        }
+        entry.output_fids.resize(part_count);
+        if (part_count > 0 && std::fread(entry.output_fids.data(), sizeof(GIntBig), part_count, file) != part_count) {
+            std::cerr << "WARNING: " << m_filename << " is truncated, rebuilding the output.\n";
+            m_entries.clear();
+            std::fclose(file);
+            return false;
+        }
+        m_entries.emplace(fid, std::move(entry));
+    }
+    std::fclose(file);
+    return true;
+}
+
+void IncrementalIndex::save() const {
+    const std::string temp_filename = m_filename + ".tmp";
+    std::FILE* file = std::fopen(temp_filename.c_str(), "wb");
+    if (!file) {
+        std::cerr << "ERROR: failed to open " << temp_filename << ": " << std::strerror(errno) << '\n';
+        exit(1);
+    }
+    if (std::fwrite("LSSINDEX", 8, 1, file) != 1) {
+        std::cerr << "ERROR: writing " << temp_filename << " failed: " << std::strerror(errno) << '\n';
+        exit(1);
+    }
+    write_value(file, VERSION, temp_filename);
+    write_value(file, m_fingerprint, temp_filename);
+    write_value(file, static_cast<uint64_t>(m_entries.size()), temp_filename);
+    for (const std::pair<const GIntBig, Entry>& entry : m_entries) {
+        write_value(file, entry.first, temp_filename);
+        write_value(file, entry.second.hash, temp_filename);
+        write_value(file, static_cast<uint32_t>(entry.second.output_fids.size()), temp_filename);
+        for (const GIntBig fid : entry.second.output_fids) {
+            write_value(file, fid, temp_filename);
+        }
+    }
+    if (std::fclose(file) != 0) {
+        std::cerr << "ERROR: writing " << temp_filename << " failed: " << std::strerror(errno) << '\n';
+        exit(1);
+    }
+    if (std::rename(temp_filename.c_str(), m_filename.c_str()) != 0) {
+        std::cerr << "ERROR: failed to rename " << temp_filename << " to " << m_filename << ": "
+            << std::strerror(errno) << '\n';
+        exit(1);
+    }
+}
+
+IncrementalIndex::Entry* IncrementalIndex::find(const GIntBig fid) {
+    auto it = m_entries.find(fid);
+    if (it == m_entries.end()) {
+        return nullptr;
+    }
+    return &it->second;
+}
+
+void IncrementalIndex::set(const GIntBig fid, const uint64_t hash, std::vector<GIntBig>&& output_fids) {
+    Entry& entry = m_entries[fid];
+    entry.hash = hash;
+    entry.output_fids = std::move(output_fids);
+    entry.seen = true;
+}
+
+void IncrementalIndex::remove_unseen(const std::function<void(GIntBig, const Entry&)>& callback) {
+    for (auto it = m_entries.begin(); it != m_entries.end();) {
+        if (it->second.seen) {
+            ++it;
+        } else {
+            callback(it->first, it->second);
+            it = m_entries.erase(it);
+        }
+    }
+}
+
+/*static*/ uint64_t IncrementalIndex::hash(const char* data, const size_t size, uint64_t hash) noexcept {
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
@@ -0,0 +1,96 @@
+/*
+ *  © 2018 Geofabrik GmbH
+ *
+ *  This file is part of LinestringsSplitter.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef INCREMENTAL_INDEX_HPP_
+#define INCREMENTAL_INDEX_HPP_
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <gdal/ogr_api.h>
+
+/**
+ * Sidecar index of the incremental mode. It maps the FID of every input feature to a hash of
+ * its content (geometry and attributes) and the FIDs of the parts written to the output.
+ *
+ * File layout (native byte order): magic bytes "LSSINDEX", uint32 version, uint64 fingerprint
+ * of the options, uint64 number of entries, followed by the entries: int64 input FID, uint64
+ * content hash, uint32 number of parts and the int64 FIDs of the parts.
+ */
+class IncrementalIndex {
+public:
+    struct Entry {
+        uint64_t hash = 0;
+
+        std::vector<GIntBig> output_fids;
+
+        /// input feature still exists
+        bool seen = false;
+    };
+
+private:
+    static constexpr uint32_t VERSION = 1;
+
+    std::string m_filename;
+
+    uint64_t m_fingerprint;
+
+    std::unordered_map<GIntBig, Entry> m_entries;
+
+public:
+    /**
+     * \param fingerprint hash of all options which influence the output, an index written with
+     *        a different fingerprint is not used
+     */
+    IncrementalIndex(const std::string& filename, const uint64_t fingerprint);
+
+    /**
+     * Read the index file. Returns false if the file does not exist or cannot be used.
+     */
+    bool load();
+
+    /**
+     * Write the index atomically (write a temporary file and rename it).
+     */
+    void save() const;
+
+    Entry* find(const GIntBig fid);
+
+    void set(const GIntBig fid, const uint64_t hash, std::vector<GIntBig>&& output_fids);
+
+    /**
+     * Call the callback for all entries of input features which have not been seen and remove them.
+     */
+    void remove_unseen(const std::function<void(GIntBig, const Entry&)>& callback);
+
+    size_t size() const noexcept {
+        return m_entries.size();
+    }
+
+    /**
+     * 64 bit FNV-1a hash, call it with the result of the previous call to hash multiple buffers.
+     */
+    static uint64_t hash(const char* data, const size_t size, uint64_t hash = 0xcbf29ce484222325ULL) noexcept;
+};
+
+#endif /* INCREMENTAL_INDEX_HPP_ */
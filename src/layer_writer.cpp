@@ -0,0 +1,355 @@
+/*
+ *  © 2018 Geofabrik GmbH
+ *
+ *  This file is part of LinestringsSplitter.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "layer_writer.hpp"
+
+#include <iostream>
+
+#include <unistd.h>
+
+#include "attributes.hpp"
+#include "memory.hpp"
+#include "part_record.hpp"
+#include "stats.hpp"
+#include "trace.hpp"
+
+gdal_dataset_type create_data_source(const std::string& format, const std::string& filename,
+        const char* const* creation_options, const bool overwrite) {
+#if GDAL_VERSION_MAJOR >= 2
+    gdal_driver_type* out_driver = GetGDALDriverManager()->GetDriverByName(format.c_str());
+#else
+    gdal_driver_type* out_driver = OGRSFDriverRegistrar::GetRegistrar()->GetDriverByName(format.c_str());
+#endif
+    if (out_driver == NULL) {
+        std::cerr << "ERROR: failed to load driver for " << format << '\n';
+        exit(1);
+    }
+    if (overwrite && access(filename.c_str(), F_OK) == 0) {
+#if GDAL_VERSION_MAJOR >= 2
+        out_driver->Delete(filename.c_str());
+#else
+        out_driver->DeleteDataSource(filename.c_str());
+#endif
+    }
+    gdal_dataset_type data_source;
+#if GDAL_VERSION_MAJOR >= 2
+    data_source.reset(out_driver->Create(filename.c_str(), 0, 0, 0, GDT_Unknown, const_cast<char**>(creation_options)));
+#else
+    data_source = out_driver->CreateDataSource(filename.c_str(), const_cast<char**>(creation_options));
+#endif
+    if (data_source == NULL) {
+        std::cerr << "ERROR: failed to create data source " << filename << '\n';
+        exit(1);
+    }
+    return data_source;
+}
+
+LayerWriter::LayerWriter(const std::string& filename, OGRLayer* input_layer, Options& options, const bool update) :
+    Writer(input_layer, options),
+    m_filename(filename),
+    m_srs(nullptr),
+    m_data_source(),
+    m_layer(nullptr),
+    m_transaction_size(options.transaction_size),
+    m_commit_callback(),
+    m_written_fids() {
+    init(input_layer, update);
+}
+
+void LayerWriter::init(OGRLayer* input_layer, const bool update) {
+    // Every writer has its own copy of the SRS because writers might run in different threads.
+    if (input_layer->GetSpatialRef()) {
+        m_srs = input_layer->GetSpatialRef()->Clone();
+    }
+    if (update) {
+        open_layer(input_layer);
+    } else {
+        create_layer(input_layer);
+    }
+    if (m_layer->StartTransaction() != OGRERR_NONE) {
+        std::cerr << "Failed to start transaction in output layer.\n";
+        exit(1);
+    }
+}
+
+void LayerWriter::open_layer(OGRLayer* input_layer) {
+#if GDAL_VERSION_MAJOR >= 2
+    m_data_source.reset(static_cast<GDALDataset*>(GDALOpenEx(m_filename.c_str(), GDAL_OF_VECTOR | GDAL_OF_UPDATE, NULL, NULL, NULL)));
+#else
+    m_data_source = OGRSFDriverRegistrar::Open(m_filename.c_str(), TRUE);
+#endif
+    if (m_data_source == NULL) {
+        std::cerr << "ERROR: failed to open " << m_filename << " for update\n";
+        exit(1);
+    }
+    m_layer = m_data_source->GetLayerByName(input_layer->GetName());
+    if (m_layer == nullptr) {
+        std::cerr << "ERROR: layer " << input_layer->GetName() << " not found in " << m_filename << '\n';
+        exit(1);
+    }
+    m_feature_count = m_layer->GetFeatureCount(TRUE);
+    if (m_options.grid_size > 0) {
+        m_cell_x_field = m_layer->GetLayerDefn()->GetFieldIndex("cell_x");
+        m_cell_y_field = m_layer->GetLayerDefn()->GetFieldIndex("cell_y");
+        if (m_cell_x_field < 0 || m_cell_y_field < 0) {
+            std::cerr << "ERROR: " << m_filename << " has no grid cell fields\n";
+            exit(1);
+        }
+    }
+}
+
+void LayerWriter::create_layer(OGRLayer* input_layer) {
+    // An incremental run without a usable index rebuilds the output from scratch.
+    m_data_source = create_data_source(m_options.output_format, m_filename, m_options.dataset_creation_options.get(),
+            !m_options.incremental_index.empty());
+    m_layer = m_data_source->CreateLayer(
+            input_layer->GetName(),
+            m_srs,
+            wkbLineString,
+            const_cast<char**>(m_options.layer_creation_options.get())
+    );
+    if (m_layer == nullptr) {
+        std::cerr << "ERROR: failed to create layer in " << m_filename << '\n';
+        exit(1);
+    }
+    OGRFeatureDefn* input_feature_def = input_layer->GetLayerDefn();
+    for (int i = 0; i < input_feature_def->GetFieldCount(); ++i) {
+        OGRFieldDefn* field_def = input_feature_def->GetFieldDefn(i);
+        if (m_layer->CreateField(field_def, TRUE) != OGRERR_NONE) {
+            std::cerr << "Creating field " << field_def->GetNameRef() << " failed\n";
+            exit(1);
+        }
+    }
+    if (m_options.grid_size > 0) {
+        OGRFieldDefn cell_x_def {"cell_x", OFTInteger};
+        OGRFieldDefn cell_y_def {"cell_y", OFTInteger};
+        if (m_layer->CreateField(&cell_x_def, TRUE) != OGRERR_NONE
+                || m_layer->CreateField(&cell_y_def, TRUE) != OGRERR_NONE) {
+            std::cerr << "Creating grid cell fields failed\n";
+            exit(1);
+        }
+        m_cell_x_field = m_input_field_count;
+        m_cell_y_field = m_cell_x_field + 1;
+    }
+}
+
+LayerWriter::~LayerWriter() {
+    stop_thread();
+    if (m_linestring_feature) {
+        OGRFeature::DestroyFeature(m_linestring_feature);
+    }
+#if GDAL_VERSION_MAJOR < 2
+    OGRDataSource::DestroyDataSource(m_data_source);
+#endif
+    if (m_srs) {
+        m_srs->Release();
+    }
+}
+
+void LayerWriter::write_part(const double* x_coords, const double* y_coords, const int count, OGRFeature* feature,
+        const GridCell* cell) {
+    stats::StageScope stage {stats::Stage::fields};
+    OGRFeature* new_feature = OGRFeature::CreateFeature(m_layer->GetLayerDefn());
+    // copy fields
+    for (int i = 0; i < m_input_field_count; ++i) {
+        new_feature->SetField(i, feature->GetRawFieldRef(i));
+    }
+    if (cell) {
+        new_feature->SetField(m_cell_x_field, cell->x);
+        new_feature->SetField(m_cell_y_field, cell->y);
+    }
+    write_feature(new_feature, x_coords, y_coords, count);
+}
+
+void LayerWriter::write_linestring(OGRLineString* linestring, OGRFeature* feature) {
+    stats::StageScope stage {stats::Stage::fields};
+    if (!m_linestring_feature) {
+        m_linestring_feature = OGRFeature::CreateFeature(m_layer->GetLayerDefn());
+    }
+    // every field is overwritten, only the FID of the last feature has to be reset
+    m_linestring_feature->SetFID(OGRNullFID);
+    for (int i = 0; i < m_input_field_count; ++i) {
+        m_linestring_feature->SetField(i, feature->GetRawFieldRef(i));
+    }
+    stats::StageScope write_stage {stats::Stage::write};
+    if (feature->GetGeometryRef() != linestring) {
+        std::unique_ptr<OGRLineString> result {static_cast<OGRLineString*>(linestring->clone())};
+        result->assignSpatialReference(m_srs);
+        m_linestring_feature->SetGeometryDirectly(result.release());
+        create_feature(m_linestring_feature);
+        return;
+    }
+    // Lend the geometry of the input feature to the output feature instead of copying its
+    // coordinates. The caller still uses it afterwards.
+    OGRGeometry* geometry = feature->StealGeometry();
+    // getSpatialReference() returns a pointer to const since GDAL 3
+    OGRSpatialReference* input_srs = const_cast<OGRSpatialReference*>(geometry->getSpatialReference());
+    if (input_srs) {
+        // keep the SRS of the input alive while the geometry refers to the SRS of the writer
+        input_srs->Reference();
+    }
+    geometry->assignSpatialReference(m_srs);
+    m_linestring_feature->SetGeometryDirectly(geometry);
+    create_feature(m_linestring_feature);
+    geometry = m_linestring_feature->StealGeometry();
+    geometry->assignSpatialReference(input_srs);
+    if (input_srs) {
+        input_srs->Release();
+    }
+    feature->SetGeometryDirectly(geometry);
+}
+
+void LayerWriter::create_feature(OGRFeature* new_feature) {
+    if (m_layer->CreateFeature(new_feature) != OGRERR_NONE) {
+        std::cerr << "ERROR during writing a feature to " << m_filename << '\n';
+        exit(1);
+    }
+    if (!m_options.incremental_index.empty()) {
+        m_written_fids.push_back(new_feature->GetFID());
+    }
+    ++m_feature_count;
+    count_transaction();
+}
+
+void LayerWriter::write_feature(OGRFeature* new_feature, const double* x_coords, const double* y_coords, const int count) {
+    stats::StageScope stage {stats::Stage::write};
+    std::unique_ptr<OGRLineString> result {static_cast<OGRLineString*>(OGRGeometryFactory::createGeometry(wkbLineString))};
+    result->assignSpatialReference(m_srs);
+    // copy coordinates
+    result->setNumPoints(count);
+    result->setPoints(count, x_coords, y_coords);
+    new_feature->SetGeometryDirectly(result.release());
+    create_feature(new_feature);
+    OGRFeature::DestroyFeature(new_feature);
+}
+
+void LayerWriter::write_record(const std::string& record) {
+    const part_record::View view = part_record::decode(record);
+    part_record::read_coordinates(view, m_x_coords, m_y_coords);
+    OGRFeature* new_feature = OGRFeature::CreateFeature(m_layer->GetLayerDefn());
+    {
+        stats::StageScope stage {stats::Stage::fields};
+        attributes::unpack(view.attributes, m_input_field_count, new_feature);
+        if (view.has_cell) {
+            new_feature->SetField(m_cell_x_field, view.cell.x);
+            new_feature->SetField(m_cell_y_field, view.cell.y);
+        }
+    }
+    write_feature(new_feature, m_x_coords.data(), m_y_coords.data(), static_cast<int>(view.count));
+}
+
+const std::vector<GIntBig>& LayerWriter::written_fids() const noexcept {
+    return m_written_fids;
+}
+
+std::vector<GIntBig> LayerWriter::take_written_fids() {
+    std::vector<GIntBig> fids;
+    fids.swap(m_written_fids);
+    return fids;
+}
+
+void LayerWriter::delete_feature(const GIntBig fid) {
+    if (m_layer->DeleteFeature(fid) != OGRERR_NONE) {
+        std::cerr << "ERROR: failed to delete feature " << fid << " from " << m_filename << '\n';
+        exit(1);
+    }
+    --m_feature_count;
+    count_transaction();
+}
+
+void LayerWriter::set_commit_callback(std::function<void(GIntBig)>&& callback) {
+    m_commit_callback = std::move(callback);
+}
+
+void LayerWriter::end_feature() {
+    if (m_commit_callback) {
+        commit_if_necessary();
+    }
+}
+
+void LayerWriter::truncate(const GIntBig feature_count) {
+    if (m_feature_count <= feature_count) {
+        return;
+    }
+    // Collect the FIDs first, deleting features while reading the layer is not supported by all drivers.
+    std::vector<GIntBig> fids;
+    m_layer->ResetReading();
+    if (m_layer->SetNextByIndex(feature_count) == OGRERR_NONE) {
+        OGRFeature* feature;
+        while ((feature = m_layer->GetNextFeature()) != NULL) {
+            fids.push_back(feature->GetFID());
+            OGRFeature::DestroyFeature(feature);
+        }
+    }
+    m_layer->ResetReading();
+    for (const GIntBig fid : fids) {
+        delete_feature(fid);
+    }
+}
+
+void LayerWriter::count_transaction() {
+    ++m_transaction_count;
+    if (m_transaction_count % MEMORY_CHECK_INTERVAL == 0 && m_transaction_count < m_transaction_size
+            && memory::above_limit(75)) {
+        // Some drivers keep the whole transaction in memory, commit now and keep the following transactions smaller.
+        m_transaction_size = m_transaction_count / 2;
+    }
+    if (!m_commit_callback) {
+        commit_if_necessary();
+    }
+}
+
+void LayerWriter::commit_if_necessary() {
+    if (m_transaction_count > m_transaction_size) {
+        stats::StageScope stage {stats::Stage::commit};
+        trace::Span span {"commit"};
+        span.set_arg("features", m_transaction_count);
+        if (m_layer->CommitTransaction() != OGRERR_NONE) {
+            std::cerr << "Failed to commit transaction in output layer.\n";
+            exit(1);
+        }
+        if (m_commit_callback) {
+            // make sure that non-transactional drivers have written everything the checkpoint refers to
+            m_layer->SyncToDisk();
+            m_commit_callback(m_feature_count);
+        }
+        if (m_layer->StartTransaction() != OGRERR_NONE) {
+            std::cerr << "Failed to start a new transaction in output layer.\n";
+            exit(1);
+        }
+        m_transaction_count = 0;
+    }
+}
+
+void LayerWriter::finalize() {
+    stop_thread();
+    if (m_layer->CommitTransaction() != OGRERR_NONE) {
+        std::cerr << "Failed to commit transaction in output layer.\n";
+        exit(1);
+    }
+    m_layer->SyncToDisk();
+    m_layer = nullptr;
+#if GDAL_VERSION_MAJOR >= 2
+    m_data_source.reset();
+#else
+    OGRDataSource::DestroyDataSource(m_data_source);
+    m_data_source = nullptr;
+#endif
+}
@@ -0,0 +1,176 @@
+/*
+ *  © 2018 Geofabrik GmbH
+ *
+ *  This file is part of LinestringsSplitter.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef LAYER_WRITER_HPP_
+#define LAYER_WRITER_HPP_
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gdal/ogr_api.h>
+#include <gdal/ogrsf_frmts.h>
+
+#include "options.hpp"
+#include "writer.hpp"
+
+#if GDAL_VERSION_MAJOR >= 2
+    using gdal_driver_type = GDALDriver;
+    using gdal_dataset_type = std::unique_ptr<GDALDataset>;
+#else
+    using gdal_driver_type = OGRSFDriver;
+    using gdal_dataset_type = OGRDataSource*;
+#endif
+
+/**
+ * Create an OGR data source, exits on failure.
+ *
+ * \param overwrite delete an existing data source first
+ */
+gdal_dataset_type create_data_source(const std::string& format, const std::string& filename,
+        const char* const* creation_options, const bool overwrite);
+
+/**
+ * Writer using an OGR data source with a single layer which has the fields of the input layer
+ * (and the grid cell fields in grid mode).
+ */
+class LayerWriter : public Writer {
+private:
+    std::string m_filename;
+
+    OGRSpatialReference* m_srs;
+
+    gdal_dataset_type m_data_source;
+
+    OGRLayer* m_layer;
+
+    int m_transaction_count = 0;
+
+    /// number of changes per transaction, reduced if the memory limit is reached
+    int m_transaction_size;
+
+    /// number of changes between two checks of the memory limit
+    static constexpr int MEMORY_CHECK_INTERVAL = 256;
+
+    /// index of the cell_x field in the output layer (grid mode only)
+    int m_cell_x_field = -1;
+
+    /// index of the cell_y field in the output layer (grid mode only)
+    int m_cell_y_field = -1;
+
+    /// output feature reused by write_linestring(), created on first use
+    OGRFeature* m_linestring_feature = nullptr;
+
+    /// number of features in the output layer
+    GIntBig m_feature_count = 0;
+
+    /// called after every commit with the number of features in the output layer (checkpoint mode only)
+    std::function<void(GIntBig)> m_commit_callback;
+
+    /// FIDs of the features written since the last call of take_written_fids() (incremental mode only)
+    std::vector<GIntBig> m_written_fids;
+
+    void init(OGRLayer* input_layer, const bool update);
+
+    /**
+     * Create the data source and a layer with the schema of the input layer.
+     */
+    void create_layer(OGRLayer* input_layer);
+
+    /**
+     * Open an existing output data source for update.
+     */
+    void open_layer(OGRLayer* input_layer);
+
+    /**
+     * Count a change of the output layer. Commit the current transaction and start a new one if
+     * enough features have been written unless commits are restricted to the end of input features.
+     */
+    void count_transaction();
+
+    /**
+     * Commit the current transaction and start a new one if enough features have been written.
+     */
+    void commit_if_necessary();
+
+    /**
+     * Write a feature to the output layer and count it.
+     */
+    void create_feature(OGRFeature* new_feature);
+
+    /**
+     * Set the geometry of the feature, write it to the output layer and destroy it.
+     */
+    void write_feature(OGRFeature* new_feature, const double* x_coords, const double* y_coords, const int count);
+
+public:
+    /**
+     * \param filename name of the data source to create
+     * \param input_layer layer to copy name, SRS and fields from
+     * \param update open an existing data source instead of creating a new one
+     */
+    LayerWriter(const std::string& filename, OGRLayer* input_layer, Options& options, const bool update = false);
+
+    ~LayerWriter();
+
+    void write_part(const double* x_coords, const double* y_coords, const int count, OGRFeature* feature,
+            const GridCell* cell) override;
+
+    /**
+     * Copy the fields into a feature of the output layer. If the linestring is the geometry of the
+     * input feature, it is moved into the output feature for writing instead of being copied.
+     */
+    void write_linestring(OGRLineString* linestring, OGRFeature* feature) override;
+
+    void write_record(const std::string& record) override;
+
+    /**
+     * FIDs of the features written since the last call of take_written_fids() (incremental mode only).
+     */
+    const std::vector<GIntBig>& written_fids() const noexcept;
+
+    /**
+     * Get the FIDs of the features written since the last call (incremental mode only).
+     */
+    std::vector<GIntBig> take_written_fids();
+
+    void delete_feature(const GIntBig fid);
+
+    /**
+     * Commit only after an input feature has been written completely, call the callback after
+     * every commit.
+     */
+    void set_commit_callback(std::function<void(GIntBig)>&& callback);
+
+    /**
+     * Signal that all parts of an input feature have been written.
+     */
+    void end_feature();
+
+    /**
+     * Delete all features except the first feature_count ones (in the natural order of the layer).
+     */
+    void truncate(const GIntBig feature_count);
+
+    void finalize() override;
+};
+
+#endif /* LAYER_WRITER_HPP_ */
@@ -20,25 +20,110 @@
 #include <getopt.h>
 
 #include <algorithm>
+#include <chrono>
+#include <cstdlib>
 #include <cstring>
+#include <fstream>
 #include <iostream>
+#include <thread>
 
+#include "drivers.hpp"
+#include "memory.hpp"
 #include "output.hpp"
+#include "server.hpp"
+#include "stats.hpp"
+#include "trace.hpp"
 
 
 void print_help(char* arg0) {
     std::cerr << "Usage: " << arg0 << " [OPTIONS] INFILE OUTFILE\n" \
               << "Options:\n" \
               << "  -h, --help           This help message.\n" \
-              << "  -f, --format         Output format (default: SQlite)\n" \
+              << "  -f, --format         Output format (default: SQlite). Use PGCopy to write\n" \
+              << "                       into PostGIS using binary COPY, OUTFILE is a libpq\n" \
+              << "                       connection string then. --shards sets the number\n" \
+              << "                       of connections loading in parallel.\n" \
+              << "                       Use WKBStream to write a binary stream of WKB\n" \
+              << "                       geometries and attributes (see stream_reader.hpp),\n" \
+              << "                       OUTFILE - writes to stdout.\n" \
+              << "  --changes FILE       Write the change set of an incremental run to FILE:\n" \
+              << "                       output parts with an op field (insert, delete,\n" \
+              << "                       unchanged) and their identity (src_fid, part_index)\n" \
+              << "                       and FID in the output (out_fid).\n" \
+              << "  --changes-format FORMAT  Output format of the change set (default: GPKG)\n" \
+              << "  --changes-unchanged  Add unchanged parts to the change set.\n" \
+              << "  --checkpoint         Write OUTFILE.checkpoint after every commit of the\n" \
+              << "                       output. Commits only happen between input features.\n" \
               << "  --dsco KEY=VALUE     Dataset creation options for output format\n" \
               << "  --geographic         Treat coordinates as geographic (lat/long) and\n" \
               << "                       calculate distances on a sphere. This option is\n" \
               << "                       not required if the coordinate system is recognized\n" \
               << "                       correctly.\n" \
+              << "  --grid SIZE          Split linestrings where they cross the lines of a grid\n" \
+              << "                       with cells of SIZE × SIZE (in units of the input\n" \
+              << "                       coordinate system) instead of splitting them by\n" \
+              << "                       length. The fields cell_x and cell_y of the output\n" \
+              << "                       contain the column and row of the cell of each part.\n" \
               << "  --gt NUMBER          Group NUMBER features per transaction\n" \
+              << "  --incremental INDEX  Update an existing output: only new, changed or deleted\n" \
+              << "                       input features are processed. INDEX is a sidecar file\n" \
+              << "                       with hashes of the input features and the FIDs of\n" \
+              << "                       their parts. Requires stable FIDs in input and output\n" \
+              << "                       (e.g. GPKG, not ESRI Shapefile output).\n" \
               << "  --lco  KEY=VALUE     Options for output format\n" \
+              << "  --manifest FILE      Process the jobs listed in FILE instead of INFILE, one\n" \
+              << "                       job per line: its options, INFILE and OUTFILE\n" \
+              << "                       separated by tabs (or spaces if the line contains no\n" \
+              << "                       tab). Empty lines and lines starting with # are\n" \
+              << "                       ignored. Jobs run concurrently within --workers\n" \
+              << "                       threads (a job uses one thread plus one per shard)\n" \
+              << "                       and share --memory-limit. One line of JSON with the\n" \
+              << "                       result of each job is written to stdout.\n" \
+              << "  --progress SECONDS   Report the progress (rates, percentage done, ETA) on\n" \
+              << "                       stderr every SECONDS seconds.\n" \
+              << "  --serve SOCKET       Run as a daemon listening on the Unix socket SOCKET\n" \
+              << "                       for jobs instead of processing INFILE. Every line\n" \
+              << "                       sent is a job: its command line arguments separated\n" \
+              << "                       by tabs. The result of every job is returned as one\n" \
+              << "                       line of JSON with its exit status, wall, user and\n" \
+              << "                       system time, peak memory and output.\n" \
+              << "  --workers N          Number of jobs --serve runs at the same time, number\n" \
+              << "                       of threads of the jobs of --manifest (default:\n" \
+              << "                       number of CPU cores).\n" \
+              << "  --resume             Continue an interrupted run with --checkpoint from its\n" \
+              << "                       checkpoint, appending to the existing output.\n" \
+              << "  --memory-limit MB    Keep the process within MB megabytes: writer queues,\n" \
+              << "                       the sort budget and the GDAL cache are limited and\n" \
+              << "                       transactions are committed early if the resident\n" \
+              << "                       memory approaches the limit.\n" \
               << "  -m NUM, --min-length NUM    minimum length in meter for circular linestrings with 5 points\n" \
+              << "  --max-file-features N  Continue ESRI Shapefile output in a new file\n" \
+              << "                       (OUTFILE with _0001, _0002 … inserted before the\n" \
+              << "                       extension) after N features.\n" \
+              << "  --max-file-size MB   Continue ESRI Shapefile output in a new file before\n" \
+              << "                       the .shp or .dbf file exceeds MB megabytes (default:\n" \
+              << "                       2 GB, the limit of the format).\n" \
+              << "  --shards N           Distribute the output over N files (OUTFILE with _0 …\n" \
+              << "                       _N-1 inserted before the extension) which are\n" \
+              << "                       written concurrently.\n" \
+              << "  --shard-by SCHEME    Assign parts to shards by: fid (hash of the input FID,\n" \
+              << "                       default), grid (hash of the grid cell, requires --grid)\n" \
+              << "                       or hilbert (ranges of the Hilbert curve).\n" \
+              << "  --sort hilbert       Sort the output by the position of the centre of the\n" \
+              << "                       bounding box of the parts on a Hilbert curve.\n" \
+              << "  --sort-memory MB     Memory budget for sorting in MB (default: 512). Larger\n" \
+              << "                       outputs are sorted using temporary files.\n" \
+              << "  --stats FILE         Write a JSON report with the start-up time, the time\n" \
+              << "                       spent in each stage, the number of features, parts\n" \
+              << "                       and vertices and the throughput to FILE (- for\n" \
+              << "                       stderr).\n" \
+              << "  --trace FILE         Write a timeline of reading, writing, commits and\n" \
+              << "                       waits in the Chrome trace event format to FILE (open\n" \
+              << "                       it with Perfetto or chrome://tracing).\n" \
+              << "  --tmp-dir DIR        Directory for temporary files (default: $TMPDIR or /tmp)\n" \
+              << "  --vrt                Write OUTFILE with the extension .vrt, a VRT file\n" \
+              << "                       combining all files of an ESRI Shapefile output into\n" \
+              << "                       one layer.\n" \
               << "  -M NUM, --max-length NUM    maximum length of a linestring\n";
 }
 
@@ -94,29 +179,192 @@ std::unique_ptr<const char*[]> options_list(const std::vector<std::string>& opti
     return ptrs;
 }
 
+#if GDAL_VERSION_MAJOR >= 2
+using input_dataset_pointer = gdal_dataset_type::pointer;
+#else
+using input_dataset_pointer = gdal_dataset_type;
+#endif
 
-int main(int argc, char* argv[]) {
+/**
+ * Register the drivers of the input and output formats only, or all drivers if the input format
+ * is not recognized by its name.
+ */
+void register_drivers(const std::string& input_filename, const Options& options) {
+    std::vector<std::string> names {drivers::driver_for(input_filename)};
+    if (options.output_format != PG_COPY_FORMAT && options.output_format != WKB_STREAM_FORMAT) {
+        names.push_back(options.output_format);
+    }
+    if (!options.changes_filename.empty()) {
+        names.push_back(options.changes_format);
+    }
+    if (names.front().empty() || !drivers::register_only(names)) {
+        drivers::register_all();
+    }
+}
+
+input_dataset_pointer open_input(const std::string& input_filename) {
+#if GDAL_VERSION_MAJOR >= 2
+    return static_cast<input_dataset_pointer>(GDALOpenEx(input_filename.c_str(), GDAL_OF_VECTOR, NULL, NULL, NULL));
+#else
+    return OGRSFDriverRegistrar::Open(input_filename.c_str());
+#endif
+}
+
+int run(int argc, char* argv[], const bool serving);
+
+/**
+ * Run a job of the --serve or --manifest mode in the current process.
+ */
+int run_job(const std::vector<std::string>& arguments) {
+    std::vector<std::string> job_arguments {"linestringssplitter"};
+    job_arguments.insert(job_arguments.end(), arguments.begin(), arguments.end());
+    std::vector<char*> job_argv;
+    for (std::string& argument : job_arguments) {
+        job_argv.push_back(&argument[0]);
+    }
+    job_argv.push_back(nullptr);
+    // reset getopt which already parsed the arguments of the server
+    optind = 0;
+    return run(static_cast<int>(job_arguments.size()), job_argv.data(), true);
+}
+
+/**
+ * Number of threads a job uses: the main thread and one writer per shard.
+ */
+int job_threads(const std::vector<std::string>& arguments) {
+    int shards = 1;
+    for (size_t i = 0; i < arguments.size(); ++i) {
+        if (arguments[i] == "--shards" && i + 1 < arguments.size()) {
+            shards = atoi(arguments[i + 1].c_str());
+        } else if (arguments[i].compare(0, 9, "--shards=") == 0) {
+            shards = atoi(arguments[i].c_str() + 9);
+        }
+    }
+    return 1 + std::max(1, shards);
+}
+
+/**
+ * Read the jobs of a manifest file. If memory_limit (in MB) is set, every job without its own
+ * --memory-limit gets the share of its threads.
+ */
+std::vector<server::BatchJob> read_manifest(const std::string& filename, const int workers, const size_t memory_limit) {
+    std::ifstream manifest {filename};
+    if (!manifest) {
+        std::cerr << "ERROR: failed to open manifest " << filename << '\n';
+        exit(1);
+    }
+    std::vector<server::BatchJob> jobs;
+    std::string line;
+    while (std::getline(manifest, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        const char separator = line.find('\t') == std::string::npos ? ' ' : '\t';
+        server::BatchJob job;
+        size_t begin = 0;
+        while (begin <= line.size()) {
+            size_t end = line.find(separator, begin);
+            if (end == std::string::npos) {
+                end = line.size();
+            }
+            if (end > begin) {
+                job.arguments.push_back(line.substr(begin, end - begin));
+            }
+            begin = end + 1;
+        }
+        job.threads = job_threads(job.arguments);
+        if (memory_limit > 0 && std::find(job.arguments.begin(), job.arguments.end(), "--memory-limit") == job.arguments.end()) {
+            const size_t share = memory_limit * static_cast<size_t>(std::min(job.threads, workers)) / static_cast<size_t>(workers);
+            job.arguments.insert(job.arguments.begin(), {"--memory-limit", std::to_string(std::max<size_t>(1, share))});
+        }
+        jobs.push_back(std::move(job));
+    }
+    return jobs;
+}
+
+/**
+ * Run the program with the given command line arguments.
+ *
+ * \param serving true if called for a job of the --serve or --manifest mode
+ */
+int run(int argc, char* argv[], const bool serving) {
+    const auto start = std::chrono::steady_clock::now();
     // parse command line arguments
 
     constexpr int dsco_option = 200;
     constexpr int gt_option = 201;
     constexpr int lco_optoin = 202;
+    constexpr int grid_option = 203;
+    constexpr int sort_option = 204;
+    constexpr int sort_memory_option = 205;
+    constexpr int tmp_dir_option = 206;
+    constexpr int shards_option = 207;
+    constexpr int shard_by_option = 208;
+    constexpr int incremental_option = 209;
+    constexpr int changes_option = 210;
+    constexpr int changes_format_option = 211;
+    constexpr int changes_unchanged_option = 212;
+    constexpr int checkpoint_option = 213;
+    constexpr int resume_option = 214;
+    constexpr int stats_option = 215;
+    constexpr int progress_option = 216;
+    constexpr int trace_option = 217;
+    constexpr int memory_limit_option = 218;
+    constexpr int max_file_size_option = 219;
+    constexpr int max_file_features_option = 220;
+    constexpr int vrt_option = 221;
+    constexpr int serve_option = 222;
+    constexpr int workers_option = 223;
+    constexpr int manifest_option = 224;
 
     static struct option long_options[] = {
         {"help", no_argument, 0, 'h'},
         {"format", required_argument, 0, 'f'},
+        {"changes", required_argument, 0, changes_option},
+        {"changes-format", required_argument, 0, changes_format_option},
+        {"changes-unchanged", no_argument, 0, changes_unchanged_option},
+        {"checkpoint", no_argument, 0, checkpoint_option},
         {"dsco", required_argument, 0, dsco_option},
+        {"grid", required_argument, 0, grid_option},
         {"gt", required_argument, 0, gt_option},
+        {"incremental", required_argument, 0, incremental_option},
         {"lco", required_argument, 0, lco_optoin},
+        {"manifest", required_argument, 0, manifest_option},
         {"min-length", required_argument, 0, 'm'},
         {"max-length", required_argument, 0, 'M'},
+        {"max-file-features", required_argument, 0, max_file_features_option},
+        {"max-file-size", required_argument, 0, max_file_size_option},
+        {"memory-limit", required_argument, 0, memory_limit_option},
+        {"progress", required_argument, 0, progress_option},
+        {"resume", no_argument, 0, resume_option},
+        {"serve", required_argument, 0, serve_option},
+        {"shards", required_argument, 0, shards_option},
+        {"shard-by", required_argument, 0, shard_by_option},
+        {"sort", required_argument, 0, sort_option},
+        {"sort-memory", required_argument, 0, sort_memory_option},
+        {"stats", required_argument, 0, stats_option},
+        {"trace", required_argument, 0, trace_option},
+        {"tmp-dir", required_argument, 0, tmp_dir_option},
+        {"vrt", no_argument, 0, vrt_option},
+        {"workers", required_argument, 0, workers_option},
         {0, 0, 0, 0}
     };
     Options options;
+    const char* tmpdir = std::getenv("TMPDIR");
+    if (tmpdir) {
+        options.temp_directory = tmpdir;
+    }
     std::vector<std::string> dsco_vector;
     std::unique_ptr<const char*[]> dsco;
     std::vector<std::string> lco_vector;
     std::unique_ptr<const char*[]> lco;
+    bool rollover_options = false;
+    std::string serve_socket;
+    std::string manifest_filename;
+    int workers = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
     while (true) {
         int c = getopt_long(argc, argv, "hf:m:M:", long_options, 0);
         if (c == -1) {
@@ -138,15 +386,122 @@ int main(int argc, char* argv[]) {
             lco_vector = get_options_vector(optarg);
             options.layer_creation_options = options_list(lco_vector);
             break;
+        case changes_option:
+            options.changes_filename = optarg;
+            break;
+        case changes_format_option:
+            options.changes_format = optarg;
+            break;
+        case changes_unchanged_option:
+            options.changes_unchanged = true;
+            break;
+        case checkpoint_option:
+            options.checkpoint = true;
+            break;
+        case resume_option:
+            options.checkpoint = true;
+            options.resume = true;
+            break;
+        case incremental_option:
+            options.incremental_index = optarg;
+            break;
         case gt_option:
             options.transaction_size = std::atoi(optarg);
             break;
+        case grid_option:
+            options.grid_size = std::atof(optarg);
+            if (options.grid_size <= 0) {
+                std::cerr << "ERROR: grid size must be larger than 0\n";
+                exit(1);
+            }
+            break;
         case 'm':
             options.min_length = std::atoi(optarg);
             break;
         case 'M':
             options.max_length = std::atoi(optarg);
             break;
+        case shards_option:
+            options.shards = std::atoi(optarg);
+            if (options.shards < 1) {
+                std::cerr << "ERROR: number of shards must be at least 1\n";
+                exit(1);
+            }
+            break;
+        case shard_by_option:
+            if (!std::strcmp(optarg, "fid")) {
+                options.shard_scheme = ShardScheme::fid;
+            } else if (!std::strcmp(optarg, "grid")) {
+                options.shard_scheme = ShardScheme::grid;
+            } else if (!std::strcmp(optarg, "hilbert")) {
+                options.shard_scheme = ShardScheme::hilbert;
+            } else {
+                std::cerr << "ERROR: unknown sharding scheme " << optarg << '\n';
+                exit(1);
+            }
+            break;
+        case sort_option:
+            if (std::strcmp(optarg, "hilbert")) {
+                std::cerr << "ERROR: unknown sort order " << optarg << '\n';
+                exit(1);
+            }
+            options.sort_hilbert = true;
+            break;
+        case sort_memory_option:
+            options.sort_memory = static_cast<size_t>(std::atol(optarg)) * 1024 * 1024;
+            break;
+        case memory_limit_option:
+            options.memory_limit = static_cast<size_t>(std::atol(optarg)) * 1024 * 1024;
+            break;
+        case max_file_size_option:
+            options.max_file_size = static_cast<size_t>(std::atol(optarg)) * 1024 * 1024;
+            if (options.max_file_size == 0) {
+                std::cerr << "ERROR: --max-file-size must be at least 1 MB\n";
+                exit(1);
+            }
+            rollover_options = true;
+            break;
+        case max_file_features_option:
+            options.max_file_features = std::atoll(optarg);
+            if (options.max_file_features < 1) {
+                std::cerr << "ERROR: --max-file-features must be at least 1\n";
+                exit(1);
+            }
+            rollover_options = true;
+            break;
+        case vrt_option:
+            options.write_vrt = true;
+            rollover_options = true;
+            break;
+        case progress_option:
+            options.progress_interval = std::atof(optarg);
+            if (options.progress_interval <= 0) {
+                std::cerr << "ERROR: --progress requires a positive number of seconds\n";
+                exit(1);
+            }
+            break;
+        case stats_option:
+            options.stats_filename = optarg;
+            break;
+        case trace_option:
+            options.trace_filename = optarg;
+            break;
+        case tmp_dir_option:
+            options.temp_directory = optarg;
+            break;
+        case serve_option:
+            serve_socket = optarg;
+            break;
+        case manifest_option:
+            manifest_filename = optarg;
+            break;
+        case workers_option:
+            workers = atoi(optarg);
+            if (workers < 1) {
+                std::cerr << "ERROR: --workers requires a positive number\n";
+                exit(1);
+            }
+            break;
         default:
             std::cerr << "ERROR: unknown command line option\n";
             print_help(argv[0]);
@@ -155,22 +510,104 @@ int main(int argc, char* argv[]) {
         }
     }
     int remaining_args = argc - optind;
+    if (!serve_socket.empty()) {
+        if (serving || remaining_args != 0 || !manifest_filename.empty()) {
+            std::cerr << "ERROR: --serve takes no positional arguments and cannot be used with --manifest or in a job\n";
+            exit(1);
+        }
+        drivers::register_all();
+        return server::serve(serve_socket, workers, run_job);
+    }
+    if (!manifest_filename.empty()) {
+        if (serving || remaining_args != 0) {
+            std::cerr << "ERROR: --manifest takes no positional arguments and cannot be used in a job\n";
+            exit(1);
+        }
+        const std::vector<server::BatchJob> jobs = read_manifest(manifest_filename, workers,
+                options.memory_limit / (1024 * 1024));
+        drivers::register_all();
+        return server::run_batch(jobs, workers, run_job);
+    }
     if (remaining_args != 2) {
         std::cerr << "ERROR: two positional arguments requried\n";
         print_help(argv[0]);
         exit(1);
     }
     std::string input_filename =  argv[optind];
+    options.input_filename = input_filename;
     options.output_filename = argv[optind+1];
+    if (options.shards > 1 && options.output_filename == "-") {
+        std::cerr << "ERROR: output to stdout cannot be sharded\n";
+        exit(1);
+    }
+    if (!options.incremental_index.empty()) {
+        if (options.shards > 1 || options.sort_hilbert || options.output_format == PG_COPY_FORMAT
+                || options.output_format == WKB_STREAM_FORMAT || options.output_format == "ESRI Shapefile") {
+            std::cerr << "ERROR: --incremental cannot be combined with sharding, sorting, the " << PG_COPY_FORMAT
+                << ", " << WKB_STREAM_FORMAT << " and ESRI Shapefile output formats\n";
+            exit(1);
+        }
+    }
+    if (options.checkpoint) {
+        if (options.shards > 1 || options.sort_hilbert || !options.incremental_index.empty()
+                || options.output_format == PG_COPY_FORMAT || options.output_format == WKB_STREAM_FORMAT) {
+            std::cerr << "ERROR: --checkpoint and --resume cannot be combined with sharding, sorting, the incremental mode, "
+                << "the " << PG_COPY_FORMAT << " and " << WKB_STREAM_FORMAT << " output formats\n";
+            exit(1);
+        }
+    }
+    if (!options.changes_filename.empty() && options.incremental_index.empty()) {
+        std::cerr << "ERROR: --changes requires --incremental\n";
+        exit(1);
+    }
+    if (rollover_options && (options.output_format != "ESRI Shapefile" || options.checkpoint
+            || options.dataset_creation_options || options.layer_creation_options)) {
+        std::cerr << "ERROR: --max-file-size, --max-file-features and --vrt require ESRI Shapefile output "
+            << "without --checkpoint, --dsco and --lco\n";
+        exit(1);
+    }
+    if (options.shards > 1 && options.shard_scheme == ShardScheme::grid && options.grid_size <= 0) {
+        std::cerr << "ERROR: --shard-by grid requires --grid\n";
+        exit(1);
+    }
+
+    if (!options.stats_filename.empty()) {
+        stats::enable();
+    }
+    if (options.memory_limit > 0) {
+        memory::set_limit(options.memory_limit);
+        // A quarter of the budget goes to the queues of the writers, see Writer.
+        options.sort_memory = std::min(options.sort_memory, options.memory_limit / 4);
+    }
+    if (!options.trace_filename.empty()) {
+        // 56 bytes per event (see trace.cpp), i.e. at most 14 MiB for each thread including every writer thread
+        trace::enable(1 << 18);
+    }
 
     // set up input file
-#if GDAL_VERSION_MAJOR >= 2
-    GDALAllRegister();
-    gdal_dataset_type::pointer input_data_source {static_cast<gdal_dataset_type::pointer>(GDALOpenEx(input_filename.c_str(), GDAL_OF_VECTOR, NULL, NULL, NULL))};
-#else
-    OGRRegisterAll();
-    gdal_dataset_type* input_data_source = OGRSFDriverRegistrar::Open(input_filename.c_str());
-#endif
+    std::chrono::duration<double> register_time {0.0};
+    std::chrono::duration<double> open_time {0.0};
+    auto step_start = std::chrono::steady_clock::now();
+    register_drivers(input_filename, options);
+    register_time += std::chrono::steady_clock::now() - step_start;
+    step_start = std::chrono::steady_clock::now();
+    input_dataset_pointer input_data_source = open_input(input_filename);
+    open_time += std::chrono::steady_clock::now() - step_start;
+    if (input_data_source == nullptr && !drivers::all_registered()) {
+        // The name of the input suggested the wrong driver.
+        step_start = std::chrono::steady_clock::now();
+        drivers::register_all();
+        register_time += std::chrono::steady_clock::now() - step_start;
+        step_start = std::chrono::steady_clock::now();
+        input_data_source = open_input(input_filename);
+        open_time += std::chrono::steady_clock::now() - step_start;
+    }
+    const std::chrono::duration<double> startup_time = std::chrono::steady_clock::now() - start;
+    stats::startup.register_drivers = register_time.count();
+    stats::startup.open_input = open_time.count();
+    stats::startup.total = startup_time.count();
+    stats::startup.drivers = drivers::count();
+    stats::startup.all_drivers = drivers::all_registered();
 
     if (input_data_source == nullptr) {
         std::cerr << "ERROR: Open of " << input_filename << " failed.\n";
@@ -190,11 +627,23 @@ int main(int argc, char* argv[]) {
     Output output {input_layer, options};
     output.run();
     output.finalize();
+    if (!options.stats_filename.empty()) {
+        const std::chrono::duration<double> wall_time = std::chrono::steady_clock::now() - start;
+        stats::write_report(options.stats_filename, wall_time.count());
+    }
+    if (!options.trace_filename.empty()) {
+        trace::write(options.trace_filename);
+    }
 #if GDAL_VERSION_MAJOR >= 2
     GDALClose(static_cast<GDALDatasetH>(input_data_source));
 #else
     OGRDataSource::DestroyDataSource(input_data_source);
     OGRCleanupAll();
 #endif
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    return run(argc, argv, false);
 }
 
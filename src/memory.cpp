@@ -0,0 +1,82 @@
+/*
+ *  © 2018 Geofabrik GmbH
+ *
+ *  This file is part of LinestringsSplitter.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "memory.hpp"
+
+#include <cstdio>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <gdal/gdal.h>
+
+namespace memory {
+
+    Account queues;
+
+    Account sorter;
+
+    size_t limit = 0;
+
+    void set_limit(const size_t bytes) {
+        limit = bytes;
+        // The block cache defaults to 5 % of the physical memory, which may exceed the whole budget.
+        if (static_cast<size_t>(GDALGetCacheMax64()) > limit / 8) {
+            GDALSetCacheMax64(static_cast<GIntBig>(limit / 8));
+        }
+    }
+
+    size_t current_rss() {
+        FILE* statm = std::fopen("/proc/self/statm", "r");
+        if (!statm) {
+            return 0;
+        }
+        unsigned long size = 0;
+        unsigned long resident = 0;
+        const int fields = std::fscanf(statm, "%lu %lu", &size, &resident);
+        std::fclose(statm);
+        if (fields != 2) {
+            return 0;
+        }
+        return static_cast<size_t>(resident) * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    }
+
+    size_t peak_rss() {
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) != 0) {
+            return 0;
+        }
+#ifdef __APPLE__
+        return static_cast<size_t>(usage.ru_maxrss);
+#else
+        // kilobytes on Linux
+        return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+    }
+
+    bool above_limit(const int percent) {
+        return limit > 0 && current_rss() > limit / 100 * static_cast<size_t>(percent);
+    }
+
+    size_t gdal_cache_used() {
+        return static_cast<size_t>(GDALGetCacheUsed64());
+    }
+
+} // namespace memory
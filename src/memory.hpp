@@ -0,0 +1,106 @@
+/*
+ *  © 2018 Geofabrik GmbH
+ *
+ *  This file is part of LinestringsSplitter.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef MEMORY_HPP_
+#define MEMORY_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Accounting of the memory held by the buffers of the splitter and the process as a whole,
+ * and the budget set by --memory-limit.
+ */
+namespace memory {
+
+    /**
+     * Number of bytes held by one kind of buffer (summed over all threads) and its maximum.
+     */
+    class Account {
+        std::atomic<int64_t> m_current;
+
+        std::atomic<int64_t> m_peak;
+
+    public:
+        Account() noexcept :
+            m_current(0),
+            m_peak(0) {
+        }
+
+        void add(const size_t bytes) noexcept {
+            const int64_t current = m_current.fetch_add(static_cast<int64_t>(bytes), std::memory_order_relaxed)
+                + static_cast<int64_t>(bytes);
+            int64_t peak = m_peak.load(std::memory_order_relaxed);
+            while (current > peak && !m_peak.compare_exchange_weak(peak, current, std::memory_order_relaxed)) {
+            }
+        }
+
+        void sub(const size_t bytes) noexcept {
+            m_current.fetch_sub(static_cast<int64_t>(bytes), std::memory_order_relaxed);
+        }
+
+        int64_t current() const noexcept {
+            return m_current.load(std::memory_order_relaxed);
+        }
+
+        int64_t peak() const noexcept {
+            return m_peak.load(std::memory_order_relaxed);
+        }
+    };
+
+    /// records waiting in the queues of writer threads
+    extern Account queues;
+
+    /// records held in memory by the external sorter
+    extern Account sorter;
+
+    /// Memory budget of the process in bytes (--memory-limit), 0 if there is none.
+    extern size_t limit;
+
+    /**
+     * Set the memory budget and limit the cache of GDAL to a share of it.
+     */
+    void set_limit(const size_t bytes);
+
+    /**
+     * Resident set size of the process in bytes, 0 if it cannot be determined.
+     */
+    size_t current_rss();
+
+    /**
+     * Maximum resident set size of the process so far in bytes.
+     */
+    size_t peak_rss();
+
+    /**
+     * Check if the resident set size exceeds the given share (in percent) of the budget.
+     * Always false if there is no budget.
+     */
+    bool above_limit(const int percent);
+
+    /**
+     * Bytes currently used by the block cache of GDAL.
+     */
+    size_t gdal_cache_used();
+
+} // namespace memory
+
+#endif /* MEMORY_HPP_ */
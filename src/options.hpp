@@ -0,0 +1,136 @@
+/*
+ *  © 2018 Geofabrik GmbH
+ *
+ *  This file is part of LinestringsSplitter.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef OPTIONS_HPP_
+#define OPTIONS_HPP_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+enum class ShardScheme {
+    /// hash of the FID of the input feature, all parts of a feature end up in the same shard
+    fid,
+    /// hash of the grid cell (requires --grid)
+    grid,
+    /// equally sized ranges of the Hilbert curve over the extent of the input layer
+    hilbert
+};
+
+/**
+ * Pseudo output format for writing directly into PostgreSQL using COPY in binary format.
+ */
+constexpr const char* PG_COPY_FORMAT = "PGCopy";
+
+/**
+ * Pseudo output format for writing a binary stream of WKB geometries and packed attributes
+ * (see stream_reader.hpp).
+ */
+constexpr const char* WKB_STREAM_FORMAT = "WKBStream";
+
+struct Options {
+    std::string input_filename;
+
+    std::string output_filename;
+
+    std::string output_format = "ESRI Shapefile";
+
+    int transaction_size = 1000;
+
+    bool geographic = false;
+
+    double min_length = 200;
+
+    double max_length = 2000;
+
+    /// Size of the grid cells to split at (in units of the input SRS), 0 disables grid mode.
+    double grid_size = 0;
+
+    /// Sort the output by the Hilbert index of the centre of the bounding box of the parts.
+    bool sort_hilbert = false;
+
+    /// Memory budget of the external sort in bytes.
+    size_t sort_memory = 512 * 1024 * 1024;
+
+    /// Directory for temporary files.
+    std::string temp_directory = "/tmp";
+
+    /// Number of output files, 1 disables sharding.
+    int shards = 1;
+
+    ShardScheme shard_scheme = ShardScheme::fid;
+
+    /// Path of the sidecar index of the incremental mode, empty if the incremental mode is disabled.
+    std::string incremental_index;
+
+    /// Output file of the change set of an incremental run, empty if no change set is written.
+    std::string changes_filename;
+
+    std::string changes_format = "GPKG";
+
+    /// Add unchanged parts to the change set.
+    bool changes_unchanged = false;
+
+    /// Write a checkpoint (OUTFILE.checkpoint) after every commit.
+    bool checkpoint = false;
+
+    /// Continue an interrupted run from its checkpoint.
+    bool resume = false;
+
+    /// Write a JSON report with timing and counters to this file (- for stderr), empty if disabled.
+    std::string stats_filename;
+
+    /// Seconds between two progress reports on stderr, 0 disables them.
+    double progress_interval = 0;
+
+    /// Write a timeline of the run in the Chrome trace event format to this file, empty if disabled.
+    std::string trace_filename;
+
+    /// Memory budget of the whole process in bytes, 0 if there is none.
+    size_t memory_limit = 0;
+
+    /// Maximum size of a .shp or .dbf file in bytes, the shapefile writer continues in a new file if it is reached.
+    size_t max_file_size = 2147483647;
+
+    /// Maximum number of features per shapefile, 0 if there is no limit.
+    int64_t max_file_features = 0;
+
+    /// Write a VRT file combining all files of a shapefile output.
+    bool write_vrt = false;
+
+    std::unique_ptr<const char*[]> dataset_creation_options;
+
+    std::unique_ptr<const char*[]> layer_creation_options;
+};
+
+/**
+ * Column and row of a cell of the grid used by the --grid mode.
+ */
+struct GridCell {
+    int x = 0;
+
+    int y = 0;
+
+    bool operator!=(const GridCell& other) const noexcept {
+        return x != other.x || y != other.y;
+    }
+};
+
+#endif /* OPTIONS_HPP_ */
@@ -21,141 +21,451 @@
 #include "output.hpp"
 #include <iostream>
 
+#include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <cstdio>
+#include <limits>
+#include <thread>
+
+#include <unistd.h>
+
+#include "attributes.hpp"
+#include "hilbert.hpp"
+#include "layer_writer.hpp"
+#include "part_record.hpp"
+#include "shapefile_writer.hpp"
+#include "stats.hpp"
+#include "trace.hpp"
+#include "stream_writer.hpp"
+#ifdef HAVE_LIBPQ
+#include "pg_copy_writer.hpp"
+#endif
+
+namespace {
+
+    /**
+     * Insert the number of the shard in front of the extension of the file name.
+     */
+    std::string shard_filename(const std::string& filename, const int shard) {
+        size_t last_slash = filename.find_last_of('/');
+        size_t dot = filename.find_last_of('.');
+        if (dot == std::string::npos || (last_slash != std::string::npos && dot < last_slash)) {
+            dot = filename.size();
+        }
+        return filename.substr(0, dot) + "_" + std::to_string(shard) + filename.substr(dot);
+    }
+
+    /**
+     * Scramble the bits of an integer (finalizer of SplitMix64).
+     */
+    uint64_t mix_bits(uint64_t value) noexcept {
+        value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+        return value ^ (value >> 31);
+    }
+
+} // anonymous namespace
 
 Output::Output(OGRLayer* input_layer, Options& options) :
     m_input_layer(input_layer),
     m_options(options),
     m_input_srs(m_input_layer->GetSpatialRef()),
-    m_out_data_source() {
+    m_writers(),
+    m_sorter(),
+    m_extent(),
+    m_sorted_x(),
+    m_sorted_y(),
+    m_index(),
+    m_changes(),
+    m_content(),
+    m_checkpoint(),
+    m_checkpoint_filename(options.output_filename + ".checkpoint"),
+    m_progress(),
+    m_batch_start(),
+    m_batch_read_time(std::chrono::steady_clock::duration::zero()) {
     init();
 }
 
 void Output::init() {
     m_geographic_mode = m_input_srs->IsGeographic() || m_options.geographic;
+    if (m_options.grid_size > 0) {
+        check_grid_extent();
+    }
 
-    // set up output file
-#if GDAL_VERSION_MAJOR >= 2
-    gdal_driver_type* out_driver = GetGDALDriverManager()->GetDriverByName(m_options.output_format.c_str());
-#else
-    gdal_driver_type* out_driver = OGRSFDriverRegistrar::GetRegistrar()->GetDriverByName(m_options.output_format.c_str());
-#endif
-    if (out_driver == NULL) {
-        std::cerr << "ERROR: failed to load driver for " << m_options.output_format << '\n';
-        exit(1);
+    // set up output files
+    if (!m_options.incremental_index.empty()) {
+        m_index.reset(new IncrementalIndex{m_options.incremental_index, options_fingerprint()});
+        const bool update = m_index->load() && access(m_options.output_filename.c_str(), F_OK) == 0;
+        if (!update && m_index->size() > 0) {
+            // the output is missing, the index is useless
+            m_index.reset(new IncrementalIndex{m_options.incremental_index, options_fingerprint()});
+        }
+        m_layer_writer = new LayerWriter{m_options.output_filename, m_input_layer, m_options, update};
+        m_writers.emplace_back(m_layer_writer);
+        if (!m_options.changes_filename.empty()) {
+            m_changes.reset(new ChangeSetWriter{m_input_layer, m_options});
+        }
+        return;
     }
-#if GDAL_VERSION_MAJOR >= 2
-    m_out_data_source.reset(out_driver->Create(m_options.output_filename.c_str(), 0, 0, 0, GDT_Unknown,
-            const_cast<char**>(m_options.dataset_creation_options.get())));
-#else
-    m_out_data_source = outDriver->CreateDataSource(m_options.output_filename.c_str(),
-            const_cast<char**>(m_options.dataset_creation_options.get()));
-#endif
-    if (m_out_data_source == NULL) {
-        std::cerr << "ERROR: failed to create data source " << m_options.output_filename << '\n';
-        exit(1);
+    if (m_options.checkpoint) {
+        init_checkpoints();
+        return;
     }
-    m_output_layer = m_out_data_source->CreateLayer(
-            m_input_layer->GetName(),
-            m_input_srs,
-            wkbLineString,
-            const_cast<char**>(m_options.layer_creation_options.get())
-    );
-    OGRFeatureDefn* input_feature_def = m_input_layer->GetLayerDefn();
-    for (int i = 0; i < input_feature_def->GetFieldCount(); ++i) {
-        OGRFieldDefn* field_def = input_feature_def->GetFieldDefn(i);
-        if (m_output_layer->CreateField(field_def, TRUE) != OGRERR_NONE) {
-            std::cerr << "Creating field " << field_def->GetNameRef() << " failed\n";
+    for (int i = 0; i < m_options.shards; ++i) {
+        m_writers.push_back(create_writer(i));
+        if (m_options.shards > 1) {
+            m_writers.back()->start_thread();
+        }
+    }
+    ignore_unused_fields();
+    if (m_options.sort_hilbert || (m_options.shards > 1 && m_options.shard_scheme == ShardScheme::hilbert)) {
+        if (m_input_layer->GetExtent(&m_extent, TRUE) != OGRERR_NONE) {
+            std::cerr << "ERROR: failed to get the extent of the input layer\n";
             exit(1);
         }
     }
+    if (m_options.sort_hilbert) {
+        m_sorter.reset(new ExternalSorter{m_options.sort_memory, m_options.temp_directory});
+    }
 }
 
 Output::~Output() {
-#if GDAL_VERSION_MAJOR < 2
-    OGRDataSource::DestroyDataSource(m_out_data_source);
-#endif
 }
 
-/*static*/ double Output::deg_to_rad(const double degree) noexcept {
-    return degree * (PI / 180.0);
+void Output::init_checkpoints() {
+    if (m_options.resume) {
+        if (!m_checkpoint.load(m_checkpoint_filename)) {
+            std::cerr << "ERROR: cannot resume, " << m_checkpoint_filename << " is missing, incomplete or malformed\n";
+            exit(1);
+        }
+        m_layer_writer = new LayerWriter{m_options.output_filename, m_input_layer, m_options, true};
+        // Drop features written after the last checkpoint by drivers without transactions.
+        m_layer_writer->truncate(m_checkpoint.output_features);
+        std::cerr << "Resuming after " << m_checkpoint.input_offset << " input features (last FID "
+            << m_checkpoint.last_input_fid << "), " << m_checkpoint.output_features << " output features.\n";
+    } else {
+        m_layer_writer = new LayerWriter{m_options.output_filename, m_input_layer, m_options};
+    }
+    m_writers.emplace_back(m_layer_writer);
+    m_layer_writer->set_commit_callback([this](GIntBig output_features) {
+        m_checkpoint.output_features = output_features;
+        m_checkpoint.save(m_checkpoint_filename);
+    });
+}
+
+void Output::ignore_unused_fields() {
+    for (const auto& writer : m_writers) {
+        if (writer->needs_attributes()) {
+            return;
+        }
+    }
+    OGRFeatureDefn* input_defn = m_input_layer->GetLayerDefn();
+    std::vector<const char*> names;
+    for (int i = 0; i < input_defn->GetFieldCount(); ++i) {
+        names.push_back(input_defn->GetFieldDefn(i)->GetNameRef());
+    }
+    names.push_back(nullptr);
+    if (m_input_layer->SetIgnoredFields(names.data()) != OGRERR_NONE) {
+        std::cerr << "WARNING: failed to disable reading the attributes of the input layer\n";
+    }
+}
+
+std::unique_ptr<Writer> Output::create_writer(const int index) {
+    if (m_options.output_format == PG_COPY_FORMAT) {
+#ifdef HAVE_LIBPQ
+        // All connections write into the same table, the first one creates it.
+        return std::unique_ptr<Writer>{new PgCopyWriter{m_options.output_filename, m_input_layer, m_options, index == 0}};
+#else
+        std::cerr << "ERROR: LinestringsSplitter was built without libpq, " << PG_COPY_FORMAT << " is not available.\n";
+        exit(1);
+#endif
+    }
+    if (m_options.output_format == WKB_STREAM_FORMAT) {
+        const std::string filename = m_options.shards > 1 ? shard_filename(m_options.output_filename, index) : m_options.output_filename;
+        return std::unique_ptr<Writer>{new StreamWriter{filename, m_input_layer, m_options}};
+    }
+    const std::string filename = m_options.shards > 1 ? shard_filename(m_options.output_filename, index) : m_options.output_filename;
+    if (ShapefileWriter::supports(filename, m_options)) {
+        return std::unique_ptr<Writer>{new ShapefileWriter{filename, m_input_layer, m_options}};
+    }
+    return std::unique_ptr<Writer>{new LayerWriter{filename, m_input_layer, m_options}};
 }
 
 double Output::distance(const double lon1, const double lat1, const double lon2, const double lat2) noexcept {
     if (m_geographic_mode) {
-        // calculate distance on sphere
-        double dx = EARTH_RADIUS_IN_METERS * deg_to_rad(lon2 - lon1);
-        double dy = EARTH_RADIUS_IN_METERS * deg_to_rad(lat2 - lat1);
-        return sqrt(dx * dx + dy * dy);
-    }
-    // calculate distance on plane
-    return sqrt((lon2 - lon1) * (lon2 - lon1) + (lat2 - lat1) * (lat2 - lat1));
-}
-
-void Output::write_part(std::vector<double>&& x_coords, std::vector<double>&& y_coords, OGRFeature* feature) {
-    OGRFeature* new_feature = OGRFeature::CreateFeature(feature->GetDefnRef());
-    // copy fields
-    for (int i = 0; i < feature->GetDefnRef()->GetFieldCount(); ++i) {
-        new_feature->SetField(i, feature->GetRawFieldRef(i));
-    }
-    std::unique_ptr<OGRLineString> result {static_cast<OGRLineString*>(OGRGeometryFactory::createGeometry(wkbLineString))};
-    result->assignSpatialReference(m_input_srs);
-    // copy coordinates
-    result->setNumPoints(static_cast<int>(x_coords.size()));
-    result->setPoints(static_cast<int>(x_coords.size()), x_coords.data(), y_coords.data());
-    new_feature->SetGeometryDirectly(result.release());
-    if (m_output_layer->CreateFeature(new_feature) != OGRERR_NONE) {
-        std::cerr << "ERROR during writing a feature\n";
-        exit(1);
+        return splitter::SphericalDistance{}(lon1, lat1, lon2, lat2);
+    }
+    return splitter::PlanarDistance{}(lon1, lat1, lon2, lat2);
+}
+
+double Output::part_length(const std::vector<double>& x_coords, const std::vector<double>& y_coords) noexcept {
+    double length = 0.0;
+    for (size_t i = 1; i < x_coords.size(); ++i) {
+        length += distance(x_coords[i - 1], y_coords[i - 1], x_coords[i], y_coords[i]);
     }
-    OGRFeature::DestroyFeature(new_feature);
+    return length;
+}
+
+void Output::write_part(std::vector<double>&& x_coords, std::vector<double>&& y_coords, OGRFeature* feature,
+        const GridCell* cell, double length) {
+    if (stats::enabled && length < 0) {
+        length = part_length(x_coords, y_coords);
+    }
+    count_part(length, x_coords.size());
+    if (m_sorter) {
+        stats::StageScope stage {stats::Stage::sort};
+        m_sorter->add(get_hilbert_index(x_coords, y_coords), part_record::encode(x_coords, y_coords, feature, cell));
+        return;
+    }
+    if (m_writers.size() > 1) {
+        const size_t shard = get_shard(feature->GetFID(), x_coords, y_coords, cell);
+        m_writers[shard]->push(part_record::encode(x_coords, y_coords, feature, cell));
+        return;
+    }
+    stats::StageScope stage {stats::Stage::write};
+    m_writers.front()->write_part(x_coords.data(), y_coords.data(), static_cast<int>(x_coords.size()), feature, cell);
+    if (m_changes) {
+        const std::vector<GIntBig>& fids = m_layer_writer->written_fids();
+        m_changes->write_insert(x_coords.data(), y_coords.data(), static_cast<int>(x_coords.size()), feature, cell,
+                fids.size() - 1, fids.back());
+    }
+}
+
+void Output::count_part(const double length, const size_t vertices) {
+    stats::count(stats::Counter::parts_out);
+    if (stats::enabled) {
+        stats::add(stats::Histogram::part_length, length);
+        stats::add(stats::Histogram::vertices_per_part, static_cast<double>(vertices));
+    }
+    ++m_feature_part_count;
+    if (m_progress) {
+        m_progress->add_part();
+    }
+}
+
+bool Output::write_unsplit(OGRFeature* feature, OGRLineString* linestring, const double length) {
+    // Sorting, sharding and change sets need the coordinates in vectors.
+    if (m_sorter || m_writers.size() > 1 || m_changes) {
+        return false;
+    }
+    count_part(length, static_cast<size_t>(linestring->getNumPoints()));
+    stats::StageScope stage {stats::Stage::write};
+    m_writers.front()->write_linestring(linestring, feature);
+    return true;
+}
+
+size_t Output::get_shard(const GIntBig fid, const std::vector<double>& x_coords, const std::vector<double>& y_coords,
+        const GridCell* cell) const noexcept {
+    const uint64_t shards = m_writers.size();
+    switch (m_options.shard_scheme) {
+    case ShardScheme::grid:
+        if (cell) {
+            const uint64_t cell_id = (static_cast<uint64_t>(static_cast<uint32_t>(cell->x)) << 32)
+                | static_cast<uint32_t>(cell->y);
+            return static_cast<size_t>(mix_bits(cell_id) % shards);
+        }
+        break;
+    case ShardScheme::hilbert:
+        // The curve has 2^(2 * HILBERT_ORDER) cells, split it into ranges of equal length.
+        return static_cast<size_t>((get_hilbert_index(x_coords, y_coords) * shards) >> (2 * HILBERT_ORDER));
+    case ShardScheme::fid:
+        break;
+    }
+    return static_cast<size_t>(mix_bits(static_cast<uint64_t>(fid)) % shards);
+}
+
+uint64_t Output::get_hilbert_index(const std::vector<double>& x_coords, const std::vector<double>& y_coords) const noexcept {
+    auto x_range = std::minmax_element(x_coords.begin(), x_coords.end());
+    auto y_range = std::minmax_element(y_coords.begin(), y_coords.end());
+    const double x = (*x_range.first + *x_range.second) / 2;
+    const double y = (*y_range.first + *y_range.second) / 2;
+    // map the centre of the bounding box onto the grid of the Hilbert curve
+    constexpr double max_cell = static_cast<double>((1u << HILBERT_ORDER) - 1);
+    const double width = m_extent.MaxX - m_extent.MinX;
+    const double height = m_extent.MaxY - m_extent.MinY;
+    const double column = width > 0 ? (x - m_extent.MinX) / width * max_cell : 0;
+    const double row = height > 0 ? (y - m_extent.MinY) / height * max_cell : 0;
+    return hilbert_index(static_cast<uint32_t>(std::min(std::max(column, 0.0), max_cell)),
+            static_cast<uint32_t>(std::min(std::max(row, 0.0), max_cell)));
+}
+
+void Output::write_sorted_part(const std::string& record) {
+    stats::StageScope stage {stats::Stage::write};
+    if (m_writers.size() == 1) {
+        m_writers.front()->write_record(record);
+        return;
+    }
+    const part_record::View view = part_record::decode(record);
+    part_record::read_coordinates(view, m_sorted_x, m_sorted_y);
+    const size_t shard = get_shard(view.fid, m_sorted_x, m_sorted_y, view.has_cell ? &view.cell : nullptr);
+    m_writers[shard]->push(std::string{record});
+}
+
+void Output::write_sorted() {
+    stats::StageScope stage {stats::Stage::sort};
+    const auto start = std::chrono::steady_clock::now();
+    trace::Span span {"merge sorted runs"};
+    span.set_arg("parts", static_cast<int64_t>(m_sorter->record_count()));
+    m_sorter->read_sorted([this](const std::string& record) {
+        write_sorted_part(record);
+    });
+    const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+    std::cerr << "Sorted " << m_sorter->record_count() << " parts using " << m_sorter->run_count()
+        << " temporary runs, writing them took " << duration.count() << " s.\n";
 }
 
 void Output::split_linestring(OGRFeature* feature, OGRLineString* linestring) {
-    if (skip_ring(linestring)) {
+    stats::StageScope stage {stats::Stage::split};
+    stats::count(stats::Counter::linestrings);
+    stats::count(stats::Counter::vertices, static_cast<uint64_t>(linestring->getNumPoints()));
+    if (m_progress) {
+        m_progress->add_vertices(static_cast<uint64_t>(linestring->getNumPoints()));
+    }
+    const LineStringPoints points {linestring};
+    if (skip_ring(points)) {
         return;
     }
-    if (m_options.transaction_size == 0) {
-        if (m_output_layer->StartTransaction() != OGRERR_NONE) {
-            std::cerr << "Failed to start transaction in output layer.\n";
-            exit(1);
+    if (m_options.grid_size > 0) {
+        split_at_grid(feature, linestring);
+        return;
+    }
+    if (m_geographic_mode) {
+        split_by_length(feature, linestring, points, splitter::SphericalDistance{});
+    } else {
+        split_by_length(feature, linestring, points, splitter::PlanarDistance{});
+    }
+}
+
+template <typename TDistance>
+void Output::split_by_length(OGRFeature* feature, OGRLineString* linestring, const LineStringPoints& points,
+        const TDistance& distance) {
+    splitter::split(points, m_options.max_length, distance, [&](const splitter::Range& range) {
+        // Most linestrings are shorter than the maximum length, they are written as they are.
+        if (range.first == 0 && range.last + 1 == points.size() && write_unsplit(feature, linestring, range.length)) {
+            return;
+        }
+        std::vector<double> x_coords;
+        std::vector<double> y_coords;
+        x_coords.reserve(range.last - range.first + 1);
+        y_coords.reserve(range.last - range.first + 1);
+        for (size_t i = range.first; i <= range.last; ++i) {
+            x_coords.push_back(points.x(i));
+            y_coords.push_back(points.y(i));
         }
+        write_part(std::move(x_coords), std::move(y_coords), feature, nullptr, range.length);
+    });
+}
+
+namespace {
+
+    /// cell indexes are written to integer fields
+    bool fits_cell_index(const double index) noexcept {
+        return index >= static_cast<double>(std::numeric_limits<int>::min())
+            && index <= static_cast<double>(std::numeric_limits<int>::max());
     }
-    double length = 0.0;
+
+} // anonymous namespace
+
+void Output::check_grid_extent() {
+    OGREnvelope extent;
+    // Do not scan the whole layer, coordinates outside the limit are caught by get_cell().
+    if (m_input_layer->GetExtent(&extent, FALSE) != OGRERR_NONE) {
+        return;
+    }
+    const double size = m_options.grid_size;
+    if (!fits_cell_index(std::floor(extent.MinX / size)) || !fits_cell_index(std::floor(extent.MaxX / size))
+            || !fits_cell_index(std::floor(extent.MinY / size)) || !fits_cell_index(std::floor(extent.MaxY / size))) {
+        std::cerr << "ERROR: --grid " << size << " is too small for the extent of the input, cell indexes exceed "
+            << std::numeric_limits<int>::max() << '\n';
+        exit(1);
+    }
+}
+
+GridCell Output::get_cell(const double x, const double y) const noexcept {
+    const double column = std::floor(x / m_options.grid_size);
+    const double row = std::floor(y / m_options.grid_size);
+    if (!fits_cell_index(column) || !fits_cell_index(row)) {
+        std::cerr << "ERROR: --grid " << m_options.grid_size << " is too small, the cell of the point (" << x
+            << ", " << y << ") exceeds the range of cell indexes\n";
+        exit(1);
+    }
+    GridCell cell;
+    cell.x = static_cast<int>(column);
+    cell.y = static_cast<int>(row);
+    return cell;
+}
+
+void Output::add_grid_crossings(const double a, const double b, std::vector<double>& crossings) const {
+    if (a == b) {
+        return;
+    }
+    const double size = m_options.grid_size;
+    const double upper = std::max(a, b);
+    for (double k = std::floor(std::min(a, b) / size) + 1; k * size < upper; k += 1) {
+        const double t = (k * size - a) / (b - a);
+        if (t > 0.0 && t < 1.0) {
+            crossings.push_back(t);
+        }
+    }
+}
+
+void Output::split_at_grid(OGRFeature* feature, OGRLineString* linestring) {
     std::vector<double> x_coords;
     std::vector<double> y_coords;
-    for (int i = 0; i != linestring->getNumPoints(); ++i) {
-        if (i > 0) {
-            length += distance(linestring->getX(i - 1), linestring->getY(i - 1), linestring->getX(i), linestring->getY(i));
-        }
-        x_coords.push_back(linestring->getX(i));
-        y_coords.push_back(linestring->getY(i));
-        if (length > m_options.max_length) {
-            write_part(std::move(x_coords), std::move(y_coords), feature);
-            x_coords = std::vector<double>();
-            y_coords = std::vector<double>();
-            x_coords.push_back(linestring->getX(i));
-            y_coords.push_back(linestring->getY(i));
-
-            length = 0.0;
-            ++m_transaction_count;
-            if (m_transaction_count > m_options.transaction_size) {
-                if (m_output_layer->CommitTransaction() != OGRERR_NONE && m_output_layer->StartTransaction() != OGRERR_NONE) {
-                    std::cerr << "Failed to start a new transaction in output layer.\n";
-                    exit(1);
-                }
-                m_transaction_count = 0;
+    std::vector<double> crossings;
+    GridCell current_cell;
+    x_coords.push_back(linestring->getX(0));
+    y_coords.push_back(linestring->getY(0));
+    for (int i = 1; i < linestring->getNumPoints(); ++i) {
+        const double x0 = linestring->getX(i - 1);
+        const double y0 = linestring->getY(i - 1);
+        const double x1 = linestring->getX(i);
+        const double y1 = linestring->getY(i);
+        crossings.clear();
+        add_grid_crossings(x0, x1, crossings);
+        add_grid_crossings(y0, y1, crossings);
+        std::sort(crossings.begin(), crossings.end());
+        crossings.push_back(1.0);
+        double t_last = 0.0;
+        for (const double t : crossings) {
+            // A segment crossing a grid corner has the same crossing twice.
+            if (t <= t_last) {
+                continue;
+            }
+            // The cell of a piece of the segment is the cell of its middle because its ends lie on grid lines.
+            const double t_middle = (t_last + t) / 2;
+            GridCell cell = get_cell(x0 + t_middle * (x1 - x0), y0 + t_middle * (y1 - y0));
+            if (x_coords.size() > 1 && cell != current_cell) {
+                const double x_split = x_coords.back();
+                const double y_split = y_coords.back();
+                write_part(std::move(x_coords), std::move(y_coords), feature, &current_cell);
+                x_coords = std::vector<double>();
+                y_coords = std::vector<double>();
+                x_coords.push_back(x_split);
+                y_coords.push_back(y_split);
+            }
+            current_cell = cell;
+            if (t == 1.0) {
+                x_coords.push_back(x1);
+                y_coords.push_back(y1);
+            } else {
+                x_coords.push_back(x0 + t * (x1 - x0));
+                y_coords.push_back(y0 + t * (y1 - y0));
             }
+            t_last = t;
         }
     }
     if (x_coords.size() > 1) {
-        write_part(std::move(x_coords), std::move(y_coords), feature);
+        write_part(std::move(x_coords), std::move(y_coords), feature, &current_cell);
     }
 }
 
 void Output::split_and_write_feature(OGRFeature* feature) {
+    m_feature_part_count = 0;
     OGRGeometry* geom = feature->GetGeometryRef();
     if (geom->IsEmpty()) {
+        stats::add(stats::Histogram::parts_per_feature, 0.0);
         return;
     }
     if (geom->getGeometryType() == wkbMultiLineString) {
@@ -166,32 +476,189 @@ void Output::split_and_write_feature(OGRFeature* feature) {
     } else if (geom->getGeometryType() == wkbLineString) {
         split_linestring(feature, static_cast<OGRLineString*>(geom));
     }
+    stats::add(stats::Histogram::parts_per_feature, static_cast<double>(m_feature_part_count));
 }
 
-bool Output::skip_ring(OGRLineString* linestring) {
-    if (linestring->get_IsClosed() && linestring->getNumPoints() > 5) {
-        return false;
+uint64_t Output::options_fingerprint() {
+    std::string options = m_options.output_format + '|' + std::to_string(m_options.min_length) + '|'
+        + std::to_string(m_options.max_length) + '|' + std::to_string(m_options.grid_size) + '|'
+        + (m_geographic_mode ? "geographic" : "planar");
+    OGRFeatureDefn* input_feature_def = m_input_layer->GetLayerDefn();
+    for (int i = 0; i < input_feature_def->GetFieldCount(); ++i) {
+        OGRFieldDefn* field_def = input_feature_def->GetFieldDefn(i);
+        options += '|' + std::string{field_def->GetNameRef()} + ':' + std::to_string(static_cast<int>(field_def->GetType()));
     }
+    return IncrementalIndex::hash(options.data(), options.size());
+}
+
+uint64_t Output::content_hash(OGRFeature* feature) {
+    m_content.clear();
+    OGRGeometry* geom = feature->GetGeometryRef();
+    if (geom) {
+        m_content.resize(static_cast<size_t>(geom->WkbSize()));
+        geom->exportToWkb(wkbNDR, reinterpret_cast<unsigned char*>(&m_content[0]));
+    }
+    attributes::pack(feature, m_content);
+    return IncrementalIndex::hash(m_content.data(), m_content.size());
+}
+
+void Output::delete_parts(const GIntBig src_fid, const std::vector<GIntBig>& output_fids) {
+    for (size_t i = 0; i < output_fids.size(); ++i) {
+        m_layer_writer->delete_feature(output_fids[i]);
+        if (m_changes) {
+            m_changes->write_delete(src_fid, i, output_fids[i]);
+        }
+    }
+}
+
+void Output::update_feature(OGRFeature* feature) {
+    const uint64_t hash = content_hash(feature);
+    IncrementalIndex::Entry* entry = m_index->find(feature->GetFID());
+    if (entry) {
+        if (entry->hash == hash) {
+            entry->seen = true;
+            ++m_unchanged_count;
+            if (m_changes && m_options.changes_unchanged) {
+                for (size_t i = 0; i < entry->output_fids.size(); ++i) {
+                    m_changes->write_unchanged(feature->GetFID(), i, entry->output_fids[i]);
+                }
+            }
+            return;
+        }
+        delete_parts(feature->GetFID(), entry->output_fids);
+        ++m_changed_count;
+    } else {
+        ++m_new_count;
+    }
+    split_and_write_feature(feature);
+    m_index->set(feature->GetFID(), hash, m_layer_writer->take_written_fids());
+}
+
+bool Output::skip_ring(const LineStringPoints& points) {
+    stats::StageScope stage {stats::Stage::skip_ring};
     double length = 0.0;
-    for (int i = 1; i != linestring->getNumPoints(); ++i) {
-        length += distance(linestring->getX(i - 1), linestring->getY(i - 1), linestring->getX(i), linestring->getY(i));
+    const bool skip = m_geographic_mode
+        ? splitter::skip_ring(points, m_options.min_length, splitter::SphericalDistance{}, length)
+        : splitter::skip_ring(points, m_options.min_length, splitter::PlanarDistance{}, length);
+    if (skip) {
+        stats::count(stats::Counter::rings_skipped);
+        stats::add(stats::Histogram::dropped_ring_length, length);
+    }
+    return skip;
+}
+
+OGRFeature* Output::read_feature() {
+    stats::StageScope stage {stats::Stage::read};
+    std::chrono::steady_clock::time_point start;
+    if (trace::enabled) {
+        start = std::chrono::steady_clock::now();
+    }
+    OGRFeature* feature = m_input_layer->GetNextFeature();
+    if (trace::enabled) {
+        m_batch_read_time += std::chrono::steady_clock::now() - start;
+    }
+    if (feature) {
+        stats::count(stats::Counter::features_in);
+        if (m_progress) {
+            m_progress->add_feature();
+        }
+        if (trace::enabled) {
+            ++m_batch_size;
+        }
     }
-    return length < m_options.min_length;
+    return feature;
+}
+
+void Output::trace_batch() {
+    const auto now = std::chrono::steady_clock::now();
+    trace::record("features", m_batch_start, now, "count", m_batch_size, "read_us",
+            std::chrono::duration_cast<std::chrono::microseconds>(m_batch_read_time).count());
+    m_batch_start = now;
+    m_batch_read_time = std::chrono::steady_clock::duration::zero();
+    m_batch_size = 0;
 }
 
 void Output::run() {
+    trace::set_thread_name("main");
+    m_batch_start = std::chrono::steady_clock::now();
     OGRFeature *f;
     m_input_layer->ResetReading();
-    while ((f = m_input_layer->GetNextFeature()) != NULL) {
-        split_and_write_feature(f);
+    if (m_options.resume && m_checkpoint.input_offset > 0
+            && m_input_layer->SetNextByIndex(m_checkpoint.input_offset) != OGRERR_NONE) {
+        std::cerr << "ERROR: failed to skip " << m_checkpoint.input_offset << " input features\n";
+        exit(1);
+    }
+    if (m_options.progress_interval > 0) {
+        // GetFeatureCount(FALSE) returns -1 instead of reading the whole layer if counting is expensive
+        m_progress.reset(new Progress{m_input_layer->GetFeatureCount(FALSE), m_checkpoint.input_offset,
+                m_options.progress_interval});
+        m_progress->start();
+    }
+    while ((f = read_feature()) != NULL) {
+        if (m_index) {
+            update_feature(f);
+        } else {
+            split_and_write_feature(f);
+        }
+        if (m_options.checkpoint) {
+            ++m_checkpoint.input_offset;
+            m_checkpoint.last_input_fid = f->GetFID();
+            m_layer_writer->end_feature();
+        }
         OGRFeature::DestroyFeature(f);
+        if (m_batch_size == TRACE_BATCH_SIZE) {
+            trace_batch();
+        }
+    }
+    if (trace::enabled) {
+        trace_batch();
+    }
+    if (m_index) {
+        // input features which do not exist any more
+        m_index->remove_unseen([this](GIntBig src_fid, const IncrementalIndex::Entry& entry) {
+            delete_parts(src_fid, entry.output_fids);
+            ++m_deleted_count;
+        });
+    }
+    if (m_sorter) {
+        write_sorted();
+    }
+    if (m_progress) {
+        m_progress->stop();
     }
 }
 
 void Output::finalize() {
-    if (m_output_layer->CommitTransaction() != OGRERR_NONE) {
-        std::cerr << "Failed to commit transaction in output layer.\n";
-        exit(1);
+    stats::StageScope stage {stats::Stage::finalize};
+    trace::Span span {"finalize"};
+    const auto start = std::chrono::steady_clock::now();
+    // Closing the data sources is part of the measurement because some drivers build the spatial index on close.
+    if (m_writers.size() == 1) {
+        m_writers.front()->finalize();
+    } else {
+        std::vector<std::thread> threads;
+        for (std::unique_ptr<Writer>& writer : m_writers) {
+            threads.emplace_back(&Writer::finalize, writer.get());
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+    }
+    // The index must not be written before the output has been committed.
+    if (m_options.checkpoint) {
+        // the run is complete, there is nothing to resume
+        std::remove(m_checkpoint_filename.c_str());
+    }
+    if (m_changes) {
+        m_changes->finalize();
+    }
+    if (m_index) {
+        m_index->save();
+        std::cerr << "Incremental update: " << m_unchanged_count << " unchanged, " << m_changed_count << " changed, "
+            << m_new_count << " new, " << m_deleted_count << " deleted features.\n";
+    }
+    if (m_sorter) {
+        const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+        std::cerr << "Finalizing the output (including building its spatial index) took " << duration.count() << " s.\n";
     }
-    m_output_layer->SyncToDisk();
 }
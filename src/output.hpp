@@ -21,6 +21,7 @@
 #ifndef OUTPUT_LAYER_HPP_
 #define OUTPUT_LAYER_HPP_
 
+#include <chrono>
 #include <memory>
 #include <string>
 #include <vector>
@@ -28,34 +29,49 @@
 #include <gdal/ogr_api.h>
 #include <gdal/ogrsf_frmts.h>
 
-#if GDAL_VERSION_MAJOR >= 2
-    using gdal_driver_type = GDALDriver;
-    using gdal_dataset_type = std::unique_ptr<GDALDataset>;
-#else
-    using gdal_driver_type = OGRSFDriver;
-    using gdal_dataset_type = OGRDataSource*;
-#endif
-
-struct Options {
-    std::string output_filename;
-
-    std::string output_format = "ESRI Shapefile";
-
-    int transaction_size = 1000;
-
-    bool geographic = false;
-
-    double min_length = 200;
-
-    double max_length = 2000;
+#include "changeset_writer.hpp"
+#include "checkpoint.hpp"
+#include "external_sorter.hpp"
+#include "incremental_index.hpp"
+#include "layer_writer.hpp"
+#include "options.hpp"
+#include "progress.hpp"
+#include "splitter.hpp"
+#include "writer.hpp"
+
+/**
+ * View of the vertices of a linestring for the functions of splitter.hpp which reads the
+ * coordinates from the geometry without copying them.
+ */
+class LineStringPoints {
+    const OGRLineString* m_linestring;
 
-    std::unique_ptr<const char*[]> dataset_creation_options;
+    size_t m_size;
 
-    std::unique_ptr<const char*[]> layer_creation_options;
+public:
+    explicit LineStringPoints(const OGRLineString* linestring) :
+        m_linestring(linestring),
+        m_size(static_cast<size_t>(linestring->getNumPoints())) {
+    }
+
+    size_t size() const noexcept {
+        return m_size;
+    }
+
+    double x(const size_t index) const {
+        return m_linestring->getX(static_cast<int>(index));
+    }
+
+    double y(const size_t index) const {
+        return m_linestring->getY(static_cast<int>(index));
+    }
 };
 
 class Output {
 private:
+    /// benchmarks (see benchmarks/) call private member functions
+    friend struct OutputBenchmark;
+
     OGRLayer* m_input_layer;
 
     Options& m_options;
@@ -64,32 +80,179 @@ private:
 
     bool m_geographic_mode;
 
-    gdal_dataset_type m_out_data_source;
+    /// one writer per output file (more than one if the output is sharded)
+    std::vector<std::unique_ptr<Writer>> m_writers;
+
+    /// sorter for the parts if output should be sorted, otherwise null
+    std::unique_ptr<ExternalSorter> m_sorter;
+
+    /// extent of the input layer, the Hilbert curve covers this area
+    OGREnvelope m_extent;
+
+    /// coordinate buffers used when reading sharded parts back from the sorter
+    std::vector<double> m_sorted_x;
+
+    std::vector<double> m_sorted_y;
+
+    /// sidecar index of the incremental mode, null if the incremental mode is disabled
+    std::unique_ptr<IncrementalIndex> m_index;
+
+    /// the only writer in incremental and checkpoint mode
+    LayerWriter* m_layer_writer = nullptr;
+
+    /// writer of the change set of an incremental run, null if no change set is written
+    std::unique_ptr<ChangeSetWriter> m_changes;
+
+    /// buffer for the serialized content of a feature (incremental mode)
+    std::string m_content;
+
+    /// state written to the checkpoint file after every commit (checkpoint mode only)
+    Checkpoint m_checkpoint;
+
+    std::string m_checkpoint_filename;
+
+    /// periodic progress report, null if disabled
+    std::unique_ptr<Progress> m_progress;
 
-    OGRLayer* m_output_layer;
+    /// number of input features per event in the trace
+    static constexpr int64_t TRACE_BATCH_SIZE = 1024;
 
-    int m_transaction_count = 0;
+    /// start, number of features and time spent reading of the current batch (--trace only)
+    std::chrono::steady_clock::time_point m_batch_start;
 
-    static constexpr double PI = 3.14159265358979323846;
+    int64_t m_batch_size = 0;
 
-    static constexpr const double EARTH_RADIUS_IN_METERS = 6372797.560856;
+    std::chrono::steady_clock::duration m_batch_read_time;
 
-    static double deg_to_rad(const double degree) noexcept;
+    size_t m_unchanged_count = 0;
+
+    size_t m_changed_count = 0;
+
+    size_t m_new_count = 0;
+
+    size_t m_deleted_count = 0;
+
+    /// number of parts written of the current input feature
+    size_t m_feature_part_count = 0;
 
     void init();
 
+    /**
+     * Create the writer for the given output file or the given connection of the output.
+     *
+     * \param index number of the shard or connection
+     */
+    std::unique_ptr<Writer> create_writer(const int index);
+
+    /**
+     * Set up the output of a run with checkpoints, either from scratch or resuming an earlier run.
+     */
+    void init_checkpoints();
+
+    /**
+     * Let OGR skip decoding the attributes of the input features if no writer uses them.
+     */
+    void ignore_unused_fields();
+
     double distance(const double lon1, const double lat1, const double lon2, const double lat2) noexcept;
 
-    void write_part(std::vector<double>&& x_coords, std::vector<double>&& y_coords, OGRFeature* feature);
+    /**
+     * Write a part of a feature.
+     *
+     * \param length length of the part if it is known, only used for statistics
+     */
+    void write_part(std::vector<double>&& x_coords, std::vector<double>&& y_coords, OGRFeature* feature,
+            const GridCell* cell = nullptr, double length = -1.0);
+
+    /**
+     * Count a part for the statistics and the progress report.
+     */
+    void count_part(const double length, const size_t vertices);
+
+    /**
+     * Write a linestring which does not have to be split without copying its coordinates.
+     *
+     * \returns false if the part has to go through write_part() instead
+     */
+    bool write_unsplit(OGRFeature* feature, OGRLineString* linestring, const double length);
+
+    double part_length(const std::vector<double>& x_coords, const std::vector<double>& y_coords) noexcept;
+
+    uint64_t get_hilbert_index(const std::vector<double>& x_coords, const std::vector<double>& y_coords) const noexcept;
+
+    /**
+     * Get the number of the output file a part belongs to.
+     */
+    size_t get_shard(const GIntBig fid, const std::vector<double>& x_coords, const std::vector<double>& y_coords,
+            const GridCell* cell) const noexcept;
+
+    /**
+     * Write a part read from the sorter.
+     */
+    void write_sorted_part(const std::string& record);
+
+    /**
+     * Write all parts collected by the sorter in their sorted order.
+     */
+    void write_sorted();
 
     void split_linestring(OGRFeature* feature, OGRLineString* linestring);
 
+    /**
+     * Split a linestring into parts of max_length (see splitter::split()).
+     */
+    template <typename TDistance>
+    void split_by_length(OGRFeature* feature, OGRLineString* linestring, const LineStringPoints& points,
+            const TDistance& distance);
+
+    /**
+     * Check that the cell indexes of the extent of the input fit into the integer fields of
+     * the output (if the extent is known without reading the layer).
+     */
+    void check_grid_extent();
+
+    GridCell get_cell(const double x, const double y) const noexcept;
+
+    /**
+     * Add the positions (0 < t < 1) where the segment from a to b crosses a grid line to the vector.
+     */
+    void add_grid_crossings(const double a, const double b, std::vector<double>& crossings) const;
+
+    /**
+     * Split a linestring where it crosses the lines of the grid.
+     */
+    void split_at_grid(OGRFeature* feature, OGRLineString* linestring);
+
     void split_and_write_feature(OGRFeature* feature);
 
+    /**
+     * Hash of all options and properties of the input layer which influence the output.
+     */
+    uint64_t options_fingerprint();
+
+    uint64_t content_hash(OGRFeature* feature);
+
+    /**
+     * Split and write a feature if it is new or has changed since the last run.
+     */
+    void update_feature(OGRFeature* feature);
+
+    void delete_parts(const GIntBig src_fid, const std::vector<GIntBig>& output_fids);
+
     /**
      * Check if a linestring should be skipped.
      */
-    bool skip_ring(OGRLineString* geometry);
+    bool skip_ring(const LineStringPoints& points);
+
+    /**
+     * Read the next input feature, returns null at the end of the layer.
+     */
+    OGRFeature* read_feature();
+
+    /**
+     * Add an event covering the features read and split since the last call to the trace.
+     */
+    void trace_batch();
 
 public:
 
@@ -0,0 +1,66 @@
+/*
+ *  © 2018 Geofabrik GmbH
+ *
+ *  This file is part of LinestringsSplitter.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "part_record.hpp"
+
+#include <cstring>
+
+#include "attributes.hpp"
+
+namespace part_record {
+
+    std::string encode(const std::vector<double>& x_coords, const std::vector<double>& y_coords,
+            OGRFeature* feature, const GridCell* cell) {
+        std::string record;
+        attributes::append<GIntBig>(record, feature->GetFID());
+        attributes::append<uint32_t>(record, static_cast<uint32_t>(x_coords.size()));
+        record.append(reinterpret_cast<const char*>(x_coords.data()), x_coords.size() * sizeof(double));
+        record.append(reinterpret_cast<const char*>(y_coords.data()), y_coords.size() * sizeof(double));
+        attributes::append<unsigned char>(record, cell ? 1 : 0);
+        attributes::append<int>(record, cell ? cell->x : 0);
+        attributes::append<int>(record, cell ? cell->y : 0);
+        attributes::pack(feature, record);
+        return record;
+    }
+
+    View decode(const std::string& record) {
+        View view;
+        const char* data = record.data();
+        view.fid = attributes::read<GIntBig>(data);
+        view.count = attributes::read<uint32_t>(data);
+        view.x = data;
+        data += view.count * sizeof(double);
+        view.y = data;
+        data += view.count * sizeof(double);
+        view.has_cell = attributes::read<unsigned char>(data) == 1;
+        view.cell.x = attributes::read<int>(data);
+        view.cell.y = attributes::read<int>(data);
+        view.attributes = data;
+        return view;
+    }
+
+    void read_coordinates(const View& view, std::vector<double>& x_coords, std::vector<double>& y_coords) {
+        x_coords.resize(view.count);
+        y_coords.resize(view.count);
+        std::memcpy(x_coords.data(), view.x, view.count * sizeof(double));
+        std::memcpy(y_coords.data(), view.y, view.count * sizeof(double));
+    }
+
+} // namespace part_record
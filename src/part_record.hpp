@@ -0,0 +1,75 @@
+/*
+ *  © 2018 Geofabrik GmbH
+ *
+ *  This file is part of LinestringsSplitter.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef PART_RECORD_HPP_
+#define PART_RECORD_HPP_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <gdal/ogrsf_frmts.h>
+
+#include "options.hpp"
+
+/**
+ * Serialized form of a part of a linestring and the attributes of its feature.
+ *
+ * Records are used whenever parts cannot be written at once, e.g. if they are sorted or
+ * handed over to a writer running in another thread.
+ *
+ * Layout: FID of the input feature (int64), number of points (uint32), x coordinates, y
+ * coordinates, grid cell flag (uint8), grid cell column and row (int32), packed attributes
+ * (see attributes.hpp).
+ */
+namespace part_record {
+
+    struct View {
+        GIntBig fid;
+
+        uint32_t count;
+
+        /// x coordinates, not necessarily aligned
+        const char* x;
+
+        /// y coordinates, not necessarily aligned
+        const char* y;
+
+        bool has_cell;
+
+        GridCell cell;
+
+        /// beginning of the packed attributes
+        const char* attributes;
+    };
+
+    std::string encode(const std::vector<double>& x_coords, const std::vector<double>& y_coords,
+            OGRFeature* feature, const GridCell* cell);
+
+    View decode(const std::string& record);
+
+    /**
+     * Copy the coordinates of a record into the vectors.
+     */
+    void read_coordinates(const View& view, std::vector<double>& x_coords, std::vector<double>& y_coords);
+
+} // namespace part_record
+
+#endif /* PART_RECORD_HPP_ */
@@ -0,0 +1,418 @@
+/*
+ *  © 2018 Geofabrik GmbH
+ *
+ *  This file is part of LinestringsSplitter.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "pg_copy_writer.hpp"
+
+#include <cctype>
+#include <cstring>
+#include <iostream>
+
+#include "trace.hpp"
+
+namespace {
+
+    /// OIDs of PostgreSQL types used as array elements
+    constexpr int32_t INT4_OID = 23;
+    constexpr int32_t INT8_OID = 20;
+    constexpr int32_t FLOAT8_OID = 701;
+    constexpr int32_t TEXT_OID = 25;
+
+    /// SQLSTATE of CREATE TABLE if the table exists
+    constexpr const char* DUPLICATE_TABLE_SQLSTATE = "42P07";
+
+    constexpr int64_t MICROSECONDS_PER_DAY = 86400LL * 1000000LL;
+
+    /**
+     * Number of days since 2000-01-01 (the PostgreSQL epoch) of a date in the Gregorian calendar.
+     */
+    int32_t days_since_2000(int year, const unsigned month, const unsigned day) noexcept {
+        year -= month <= 2 ? 1 : 0;
+        const int era = (year >= 0 ? year : year - 399) / 400;
+        const unsigned year_of_era = static_cast<unsigned>(year - era * 400);
+        const unsigned day_of_year = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+        const unsigned day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+        // 730425 is the number of days from 0000-03-01 to 2000-01-01
+        return static_cast<int32_t>(era * 146097 + static_cast<int>(day_of_era) - 730425);
+    }
+
+    int64_t microseconds_of_day(const OGRField* field) noexcept {
+        return (static_cast<int64_t>(field->Date.Hour) * 3600 + static_cast<int64_t>(field->Date.Minute) * 60)
+            * 1000000 + static_cast<int64_t>(static_cast<double>(field->Date.Second) * 1e6);
+    }
+
+    std::string lower(const char* str) {
+        std::string result {str};
+        for (char& c : result) {
+            c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        }
+        return result;
+    }
+
+} // anonymous namespace
+
+PgCopyWriter::PgCopyWriter(const std::string& connection_string, OGRLayer* input_layer, Options& options,
+        const bool create) :
+    Writer(input_layer, options),
+    m_connection(nullptr),
+    m_table(lower(input_layer->GetName())),
+    m_buffer() {
+    const uint32_t one = 1;
+    if (*reinterpret_cast<const unsigned char*>(&one) != 1) {
+        std::cerr << "ERROR: " << PG_COPY_FORMAT << " is only supported on little endian machines.\n";
+        exit(1);
+    }
+    // accept OGR style connection strings
+    const std::string conninfo = connection_string.compare(0, 3, "PG:") == 0 ? connection_string.substr(3) : connection_string;
+    m_connection = PQconnectdb(conninfo.c_str());
+    check_connection();
+    OGRSpatialReference* srs = input_layer->GetSpatialRef();
+    if (srs && srs->GetAuthorityName(nullptr) && !std::strcmp(srs->GetAuthorityName(nullptr), "EPSG")
+            && srs->GetAuthorityCode(nullptr)) {
+        m_srid = std::atoi(srs->GetAuthorityCode(nullptr));
+    }
+    if (create) {
+        create_table(input_layer);
+        m_create_index = true;
+    }
+    start_copy();
+}
+
+PgCopyWriter::~PgCopyWriter() {
+    stop_thread();
+    if (m_connection) {
+        PQfinish(m_connection);
+    }
+}
+
+void PgCopyWriter::check_connection() {
+    if (PQstatus(m_connection) != CONNECTION_OK) {
+        std::cerr << "ERROR: connection to database failed: " << PQerrorMessage(m_connection);
+        exit(1);
+    }
+}
+
+void PgCopyWriter::execute(const std::string& query, ExecStatusType expected) {
+    PGresult* result = PQexec(m_connection, query.c_str());
+    if (PQresultStatus(result) != expected) {
+        std::cerr << "ERROR: query failed: " << PQerrorMessage(m_connection) << "Query: " << query << '\n';
+        PQclear(result);
+        exit(1);
+    }
+    PQclear(result);
+}
+
+std::string PgCopyWriter::quote_identifier(const char* identifier) {
+    char* quoted = PQescapeIdentifier(m_connection, identifier, std::strlen(identifier));
+    if (!quoted) {
+        std::cerr << "ERROR: failed to quote identifier " << identifier << ": " << PQerrorMessage(m_connection);
+        exit(1);
+    }
+    std::string result {quoted};
+    PQfreemem(quoted);
+    return result;
+}
+
+/*static*/ const char* PgCopyWriter::pg_type(const OGRFieldType type) {
+    switch (type) {
+    case OFTInteger:
+        return "integer";
+    case OFTInteger64:
+        return "bigint";
+    case OFTReal:
+        return "double precision";
+    case OFTBinary:
+        return "bytea";
+    case OFTDate:
+        return "date";
+    case OFTTime:
+        return "time";
+    case OFTDateTime:
+        return "timestamp with time zone";
+    case OFTIntegerList:
+        return "integer[]";
+    case OFTInteger64List:
+        return "bigint[]";
+    case OFTRealList:
+        return "double precision[]";
+    case OFTStringList:
+    case OFTWideStringList:
+        return "text[]";
+    default:
+        return "text";
+    }
+}
+
+void PgCopyWriter::create_table(OGRLayer* input_layer) {
+    std::string query = "CREATE TABLE " + quote_identifier(m_table.c_str()) + " (ogc_fid bigserial PRIMARY KEY";
+    OGRFeatureDefn* input_feature_def = input_layer->GetLayerDefn();
+    for (int i = 0; i < input_feature_def->GetFieldCount(); ++i) {
+        OGRFieldDefn* field_def = input_feature_def->GetFieldDefn(i);
+        query += ", " + quote_identifier(lower(field_def->GetNameRef()).c_str()) + " " + pg_type(field_def->GetType());
+    }
+    if (m_options.grid_size > 0) {
+        query += ", cell_x integer, cell_y integer";
+    }
+    query += ", geom geometry(LineString, " + std::to_string(m_srid) + "))";
+    PGresult* result = PQexec(m_connection, query.c_str());
+    if (PQresultStatus(result) != PGRES_COMMAND_OK) {
+        const char* sqlstate = PQresultErrorField(result, PG_DIAG_SQLSTATE);
+        if (sqlstate && !std::strcmp(sqlstate, DUPLICATE_TABLE_SQLSTATE)) {
+            std::cerr << "ERROR: table " << m_table << " exists already, drop it or rename the input layer\n";
+        } else {
+            std::cerr << "ERROR: query failed: " << PQerrorMessage(m_connection) << "Query: " << query << '\n';
+        }
+        PQclear(result);
+        exit(1);
+    }
+    PQclear(result);
+}
+
+void PgCopyWriter::start_copy() {
+    std::string query = "COPY " + quote_identifier(m_table.c_str()) + " (";
+    for (int i = 0; i < m_input_field_count; ++i) {
+        query += quote_identifier(lower(m_input_defn->GetFieldDefn(i)->GetNameRef()).c_str()) + ", ";
+    }
+    if (m_options.grid_size > 0) {
+        query += "cell_x, cell_y, ";
+    }
+    query += "geom) FROM STDIN (FORMAT binary)";
+    execute(query, PGRES_COPY_IN);
+    // signature, flags and length of the header extension
+    m_buffer.append("PGCOPY\n\377\r\n\0", 11);
+    append_int32(0);
+    append_int32(0);
+}
+
+void PgCopyWriter::flush() {
+    if (m_buffer.empty()) {
+        return;
+    }
+    trace::Span span {"send COPY data"};
+    span.set_arg("bytes", static_cast<int64_t>(m_buffer.size()));
+    if (PQputCopyData(m_connection, m_buffer.data(), static_cast<int>(m_buffer.size())) != 1) {
+        std::cerr << "ERROR: sending data to the database failed: " << PQerrorMessage(m_connection);
+        exit(1);
+    }
+    m_buffer.clear();
+}
+
+void PgCopyWriter::append_int16(const int16_t value) {
+    const uint16_t v = static_cast<uint16_t>(value);
+    const char bytes[2] = {static_cast<char>(v >> 8), static_cast<char>(v)};
+    m_buffer.append(bytes, 2);
+}
+
+void PgCopyWriter::append_int32(const int32_t value) {
+    const uint32_t v = static_cast<uint32_t>(value);
+    const char bytes[4] = {static_cast<char>(v >> 24), static_cast<char>(v >> 16), static_cast<char>(v >> 8),
+            static_cast<char>(v)};
+    m_buffer.append(bytes, 4);
+}
+
+void PgCopyWriter::append_int64(const int64_t value) {
+    const uint64_t v = static_cast<uint64_t>(value);
+    append_int32(static_cast<int32_t>(v >> 32));
+    append_int32(static_cast<int32_t>(v & 0xffffffffu));
+}
+
+void PgCopyWriter::append_double(const double value) {
+    int64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    append_int64(bits);
+}
+
+template <typename T>
+void PgCopyWriter::append_array(const int32_t element_oid, const int count, const T* list) {
+    append_int32(static_cast<int32_t>(20 + count * (4 + static_cast<int>(sizeof(T)))));
+    // number of dimensions, has nulls, element type, size and lower bound of the dimension
+    append_int32(1);
+    append_int32(0);
+    append_int32(element_oid);
+    append_int32(count);
+    append_int32(1);
+    for (int i = 0; i < count; ++i) {
+        append_int32(static_cast<int32_t>(sizeof(T)));
+        if (sizeof(T) == 4) {
+            append_int32(static_cast<int32_t>(list[i]));
+        } else {
+            int64_t bits;
+            std::memcpy(&bits, &list[i], sizeof(bits));
+            append_int64(bits);
+        }
+    }
+}
+
+void PgCopyWriter::append_field(OGRFeature* feature, const int index) {
+#if GDAL_VERSION_NUM >= 2020000
+    if (!feature->IsFieldSetAndNotNull(index)) {
+#else
+    if (!feature->IsFieldSet(index)) {
+#endif
+        append_int32(-1);
+        return;
+    }
+    const OGRField* field = feature->GetRawFieldRef(index);
+    switch (m_input_defn->GetFieldDefn(index)->GetType()) {
+    case OFTInteger:
+        append_int32(4);
+        append_int32(field->Integer);
+        break;
+    case OFTInteger64:
+        append_int32(8);
+        append_int64(field->Integer64);
+        break;
+    case OFTReal:
+        append_int32(8);
+        append_double(field->Real);
+        break;
+    case OFTBinary:
+        append_int32(field->Binary.nCount);
+        m_buffer.append(reinterpret_cast<const char*>(field->Binary.paData), static_cast<size_t>(field->Binary.nCount));
+        break;
+    case OFTDate:
+        append_int32(4);
+        append_int32(days_since_2000(field->Date.Year, field->Date.Month, field->Date.Day));
+        break;
+    case OFTTime:
+        append_int32(8);
+        append_int64(microseconds_of_day(field));
+        break;
+    case OFTDateTime: {
+            int64_t timestamp = days_since_2000(field->Date.Year, field->Date.Month, field->Date.Day) * MICROSECONDS_PER_DAY
+                + microseconds_of_day(field);
+            // TZFlag 100 is UTC, every step above or below is an offset of 15 minutes. Local or unknown
+            // time zones are treated as UTC.
+            if (field->Date.TZFlag > 1) {
+                timestamp -= (static_cast<int64_t>(field->Date.TZFlag) - 100) * 15 * 60 * 1000000;
+            }
+            append_int32(8);
+            append_int64(timestamp);
+        }
+        break;
+    case OFTIntegerList:
+        append_array(INT4_OID, field->IntegerList.nCount, field->IntegerList.paList);
+        break;
+    case OFTInteger64List:
+        append_array(INT8_OID, field->Integer64List.nCount, field->Integer64List.paList);
+        break;
+    case OFTRealList:
+        append_array(FLOAT8_OID, field->RealList.nCount, field->RealList.paList);
+        break;
+    case OFTStringList:
+    case OFTWideStringList: {
+            int32_t length = 20;
+            for (int i = 0; i < field->StringList.nCount; ++i) {
+                length += 4 + static_cast<int32_t>(std::strlen(field->StringList.paList[i]));
+            }
+            append_int32(length);
+            append_int32(1);
+            append_int32(0);
+            append_int32(TEXT_OID);
+            append_int32(field->StringList.nCount);
+            append_int32(1);
+            for (int i = 0; i < field->StringList.nCount; ++i) {
+                const size_t size = std::strlen(field->StringList.paList[i]);
+                append_int32(static_cast<int32_t>(size));
+                m_buffer.append(field->StringList.paList[i], size);
+            }
+        }
+        break;
+    default: {
+            const size_t size = std::strlen(field->String);
+            append_int32(static_cast<int32_t>(size));
+            m_buffer.append(field->String, size);
+        }
+        break;
+    }
+}
+
+void PgCopyWriter::append_ewkb(const double* x_coords, const double* y_coords, const int count) {
+    // EWKB is sent in little endian byte order, only the length prefix of the field is big endian.
+    constexpr uint32_t ewkb_srid_flag = 0x20000000;
+    const uint32_t type = m_srid ? (static_cast<uint32_t>(wkbLineString) | ewkb_srid_flag) : static_cast<uint32_t>(wkbLineString);
+    const uint32_t srid = static_cast<uint32_t>(m_srid);
+    const uint32_t num_points = static_cast<uint32_t>(count);
+    append_int32(static_cast<int32_t>(1 + 4 + (m_srid ? 4 : 0) + 4 + 16 * count));
+    const size_t offset = m_buffer.size();
+    m_buffer.push_back(1);
+    m_buffer.append(reinterpret_cast<const char*>(&type), 4);
+    if (m_srid) {
+        m_buffer.append(reinterpret_cast<const char*>(&srid), 4);
+    }
+    m_buffer.append(reinterpret_cast<const char*>(&num_points), 4);
+    m_buffer.resize(offset + 9 + (m_srid ? 4 : 0) + 16 * static_cast<size_t>(count));
+    char* point = &m_buffer[offset + 9 + (m_srid ? 4 : 0)];
+    for (int i = 0; i < count; ++i) {
+        std::memcpy(point, x_coords + i, 8);
+        std::memcpy(point + 8, y_coords + i, 8);
+        point += 16;
+    }
+}
+
+void PgCopyWriter::write_part(const double* x_coords, const double* y_coords, const int count, OGRFeature* feature,
+        const GridCell* cell) {
+    append_int16(static_cast<int16_t>(m_input_field_count + (m_options.grid_size > 0 ? 2 : 0) + 1));
+    for (int i = 0; i < m_input_field_count; ++i) {
+        append_field(feature, i);
+    }
+    if (m_options.grid_size > 0) {
+        if (cell) {
+            append_int32(4);
+            append_int32(cell->x);
+            append_int32(4);
+            append_int32(cell->y);
+        } else {
+            append_int32(-1);
+            append_int32(-1);
+        }
+    }
+    append_ewkb(x_coords, y_coords, count);
+    if (m_buffer.size() > BUFFER_SIZE) {
+        flush();
+    }
+}
+
+void PgCopyWriter::finalize() {
+    stop_thread();
+    // file trailer
+    append_int16(-1);
+    flush();
+    if (PQputCopyEnd(m_connection, nullptr) != 1) {
+        std::cerr << "ERROR: finishing COPY failed: " << PQerrorMessage(m_connection);
+        exit(1);
+    }
+    PGresult* result;
+    while ((result = PQgetResult(m_connection)) != nullptr) {
+        if (PQresultStatus(result) != PGRES_COMMAND_OK) {
+            std::cerr << "ERROR: COPY failed: " << PQerrorMessage(m_connection);
+            PQclear(result);
+            exit(1);
+        }
+        PQclear(result);
+    }
+    // Building the index after loading is much faster than maintaining it for every row. If
+    // shards are loaded in parallel, CREATE INDEX waits for their COPY commands to finish.
+    if (m_create_index) {
+        trace::Span index_span {"create spatial index"};
+        execute("CREATE INDEX ON " + quote_identifier(m_table.c_str()) + " USING GIST (geom)");
+    }
+    PQfinish(m_connection);
+    m_connection = nullptr;
+}
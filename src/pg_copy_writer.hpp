@@ -0,0 +1,108 @@
+/*
+ *  © 2018 Geofabrik GmbH
+ *
+ *  This file is part of LinestringsSplitter.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef PG_COPY_WRITER_HPP_
+#define PG_COPY_WRITER_HPP_
+
+#include <string>
+#include <vector>
+
+#include <libpq-fe.h>
+
+#include "writer.hpp"
+
+/**
+ * Writer streaming parts into a PostGIS table using COPY … FROM STDIN in binary format.
+ *
+ * The geometry is sent as EWKB built directly from the coordinates. Fields of the input layer
+ * are mapped to the corresponding PostgreSQL types, list fields become arrays. The spatial
+ * index is built after loading.
+ */
+class PgCopyWriter : public Writer {
+private:
+    /// send the buffer to the server if it has grown larger than this
+    static constexpr size_t BUFFER_SIZE = 1024 * 1024;
+
+    PGconn* m_connection;
+
+    std::string m_table;
+
+    int m_srid = 0;
+
+    /// this writer created the table and builds its spatial index when it is finalized
+    bool m_create_index = false;
+
+    std::string m_buffer;
+
+    void check_connection();
+
+    /**
+     * Execute an SQL command which does not return rows.
+     */
+    void execute(const std::string& query, ExecStatusType expected = PGRES_COMMAND_OK);
+
+    std::string quote_identifier(const char* identifier);
+
+    static const char* pg_type(const OGRFieldType type);
+
+    void create_table(OGRLayer* input_layer);
+
+    void start_copy();
+
+    void flush();
+
+    void append_int16(const int16_t value);
+
+    void append_int32(const int32_t value);
+
+    void append_int64(const int64_t value);
+
+    void append_double(const double value);
+
+    /**
+     * Append a field value (length and data) in binary COPY format.
+     */
+    void append_field(OGRFeature* feature, const int index);
+
+    /**
+     * Append a one-dimensional array of fixed size elements in binary COPY format.
+     */
+    template <typename T>
+    void append_array(const int32_t element_oid, const int count, const T* list);
+
+    void append_ewkb(const double* x_coords, const double* y_coords, const int count);
+
+public:
+    /**
+     * \param connection_string libpq connection string, an optional "PG:" prefix is ignored
+     * \param input_layer layer to copy name, SRS and fields from
+     * \param create create the output table and build its spatial index in finalize()
+     */
+    PgCopyWriter(const std::string& connection_string, OGRLayer* input_layer, Options& options, const bool create);
+
+    ~PgCopyWriter();
+
+    void write_part(const double* x_coords, const double* y_coords, const int count, OGRFeature* feature,
+            const GridCell* cell) override;
+
+    void finalize() override;
+};
+
+#endif /* PG_COPY_WRITER_HPP_ */
@@ -0,0 +1,145 @@
+/*
+ *  © 2018 Geofabrik GmbH
+ *
+ *  This file is part of LinestringsSplitter.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "progress.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+namespace {
+
+    /**
+     * Read the number of bytes read and written by this process (all threads) from /proc/self/io.
+     * Both stay 0 on systems without it.
+     */
+    void read_io_counters(uint64_t& bytes_read, uint64_t& bytes_written) {
+        std::ifstream io {"/proc/self/io"};
+        std::string key;
+        uint64_t value;
+        while (io >> key >> value) {
+            if (key == "rchar:") {
+                bytes_read = value;
+            } else if (key == "wchar:") {
+                bytes_written = value;
+            }
+        }
+    }
+
+    std::string format_duration(const double seconds) {
+        const long total = static_cast<long>(seconds + 0.5);
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "%ld:%02ld:%02ld", total / 3600, (total / 60) % 60, total % 60);
+        return buffer;
+    }
+
+    double rate(const uint64_t now, const uint64_t before, const double seconds) noexcept {
+        return seconds > 0 ? static_cast<double>(now - before) / seconds : 0.0;
+    }
+
+} // anonymous namespace
+
+Progress::Progress(const int64_t total, const int64_t offset, const double interval) :
+    m_total(total),
+    m_offset(offset),
+    m_interval(static_cast<long>(interval * 1000)),
+    m_features(0),
+    m_vertices(0),
+    m_parts(0),
+    m_start(),
+    m_thread(),
+    m_mutex(),
+    m_stop_requested(),
+    m_first(),
+    m_last() {
+}
+
+Progress::~Progress() {
+    if (m_thread.joinable()) {
+        stop();
+    }
+}
+
+Progress::Sample Progress::take_sample() const {
+    Sample sample;
+    sample.time = clock::now();
+    sample.features = m_features.load(std::memory_order_relaxed);
+    sample.vertices = m_vertices.load(std::memory_order_relaxed);
+    sample.parts = m_parts.load(std::memory_order_relaxed);
+    read_io_counters(sample.bytes_read, sample.bytes_written);
+    return sample;
+}
+
+void Progress::print(const Sample& sample, const bool final) const {
+    // rates since the last report, or averages over the whole run for the final report
+    const Sample& since = final ? m_first : m_last;
+    const double seconds = std::chrono::duration<double>(sample.time - since.time).count();
+    const double elapsed = std::chrono::duration<double>(sample.time - m_start).count();
+    const uint64_t done = static_cast<uint64_t>(m_offset) + sample.features;
+    std::ostringstream line;
+    line << std::fixed << std::setprecision(1);
+    if (m_total > 0) {
+        line << '[' << std::setw(5) << 100.0 * static_cast<double>(done) / static_cast<double>(m_total) << "%] ";
+    }
+    line << done << " features (" << std::setprecision(0) << rate(sample.features, since.features, seconds)
+        << "/s), " << rate(sample.vertices, since.vertices, seconds) << " vertices/s, "
+        << rate(sample.parts, since.parts, seconds) << " parts/s, " << std::setprecision(1)
+        << "read " << static_cast<double>(sample.bytes_read - m_first.bytes_read) / 1e6 << " MB, written "
+        << static_cast<double>(sample.bytes_written - m_first.bytes_written) / 1e6 << " MB, elapsed " << format_duration(elapsed);
+    if (!final && m_total > 0 && sample.features > 0 && done < static_cast<uint64_t>(m_total)) {
+        // the average rate of this run is more stable than the current one
+        const double remaining = static_cast<double>(static_cast<uint64_t>(m_total) - done)
+            * elapsed / static_cast<double>(sample.features);
+        line << ", ETA " << format_duration(remaining);
+    }
+    line << '\n';
+    // one write per line to avoid interleaving with other messages
+    std::cerr << line.str();
+}
+
+void Progress::start() {
+    m_start = clock::now();
+    m_first = take_sample();
+    m_first.time = m_start;
+    m_last = m_first;
+    m_thread = std::thread{&Progress::run_thread, this};
+}
+
+void Progress::run_thread() {
+    std::unique_lock<std::mutex> lock {m_mutex};
+    while (!m_stop_requested.wait_for(lock, m_interval, [this]() { return m_stop; })) {
+        const Sample sample = take_sample();
+        print(sample, false);
+        m_last = sample;
+    }
+}
+
+void Progress::stop() {
+    {
+        std::lock_guard<std::mutex> lock {m_mutex};
+        m_stop = true;
+    }
+    m_stop_requested.notify_all();
+    m_thread.join();
+    print(take_sample(), true);
+}
@@ -0,0 +1,120 @@
+/*
+ *  © 2018 Geofabrik GmbH
+ *
+ *  This file is part of LinestringsSplitter.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef PROGRESS_HPP_
+#define PROGRESS_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+/**
+ * Periodic progress report on stderr (see --progress).
+ *
+ * The worker only increments relaxed atomic counters, a background thread samples them and
+ * prints rates, the percentage of the input which has been processed and an estimate of the
+ * remaining time.
+ */
+class Progress {
+    using clock = std::chrono::steady_clock;
+
+    /// number of input features, negative if unknown
+    const int64_t m_total;
+
+    /// input features processed by an earlier run (--resume)
+    const int64_t m_offset;
+
+    const std::chrono::milliseconds m_interval;
+
+    std::atomic<uint64_t> m_features;
+
+    std::atomic<uint64_t> m_vertices;
+
+    std::atomic<uint64_t> m_parts;
+
+    clock::time_point m_start;
+
+    std::thread m_thread;
+
+    std::mutex m_mutex;
+
+    std::condition_variable m_stop_requested;
+
+    bool m_stop = false;
+
+    struct Sample {
+        clock::time_point time;
+        uint64_t features = 0;
+        uint64_t vertices = 0;
+        uint64_t parts = 0;
+        uint64_t bytes_read = 0;
+        uint64_t bytes_written = 0;
+    };
+
+    /// values at the start of the run
+    Sample m_first;
+
+    /// values of the last report
+    Sample m_last;
+
+    Sample take_sample() const;
+
+    void print(const Sample& sample, const bool final) const;
+
+    void run_thread();
+
+public:
+    /**
+     * \param total number of input features, negative if it is unknown
+     * \param offset number of input features processed by an earlier run
+     * \param interval seconds between two reports
+     */
+    Progress(const int64_t total, const int64_t offset, const double interval);
+
+    Progress(const Progress&) = delete;
+
+    Progress& operator=(const Progress&) = delete;
+
+    ~Progress();
+
+    void add_feature() noexcept {
+        m_features.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void add_vertices(const uint64_t count) noexcept {
+        m_vertices.fetch_add(count, std::memory_order_relaxed);
+    }
+
+    void add_part() noexcept {
+        m_parts.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void start();
+
+    /**
+     * Stop the background thread and print a final report.
+     */
+    void stop();
+};
+
+#endif /* PROGRESS_HPP_ */
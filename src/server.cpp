@@ -0,0 +1,594 @@
+/*
+ *  © 2018 Geofabrik GmbH
+ *
+ *  This file is part of LinestringsSplitter.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "server.hpp"
+
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <map>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace server {
+
+    namespace {
+
+        /// self-pipe written to by the signal handler to wake up poll()
+        int signal_pipe[2] = {-1, -1};
+
+        volatile sig_atomic_t stop_requested = 0;
+
+        void handle_signal(int signal_number) {
+            if (signal_number != SIGCHLD) {
+                stop_requested = 1;
+            }
+            const int saved_errno = errno;
+            const char byte = 0;
+            // The pipe is non-blocking, if it is full a wake-up is pending anyway.
+            if (write(signal_pipe[1], &byte, 1) < 0) {
+                // nothing to do
+            }
+            errno = saved_errno;
+        }
+
+        struct Client {
+            int fd;
+
+            /// received data not terminated by a newline yet
+            std::string buffer;
+
+            /// number of jobs received on this connection
+            int job_count = 0;
+
+            /// number of jobs queued or running
+            int pending = 0;
+
+            /// the client closed its end of the connection
+            bool input_closed = false;
+        };
+
+        struct Job {
+            uint64_t client_id;
+
+            int number;
+
+            std::vector<std::string> arguments;
+
+            /// threads used by the job, counted against the workers of the pool
+            int threads = 1;
+        };
+
+        struct JobResult {
+            int status;
+
+            double wall_time;
+
+            /// resource usage of the process of the job, nullptr if it could not be started
+            const rusage* usage;
+
+            std::string log;
+        };
+
+        struct RunningJob {
+            Job job;
+
+            std::chrono::steady_clock::time_point start;
+
+            /// temporary file receiving stdout and stderr of the job
+            int log_fd;
+        };
+
+        void append_json_string(std::string& out, const std::string& str) {
+            out += '"';
+            for (const char c : str) {
+                switch (c) {
+                case '"':
+                    out += "\\\"";
+                    break;
+                case '\\':
+                    out += "\\\\";
+                    break;
+                case '\n':
+                    out += "\\n";
+                    break;
+                case '\t':
+                    out += "\\t";
+                    break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20) {
+                        char escaped[8];
+                        snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(c));
+                        out += escaped;
+                    } else {
+                        out += c;
+                    }
+                    break;
+                }
+            }
+            out += '"';
+        }
+
+        double seconds(const timeval& time) noexcept {
+            return static_cast<double>(time.tv_sec) + static_cast<double>(time.tv_usec) / 1e6;
+        }
+
+        /**
+         * Format the result of a job as a line of JSON (see server.hpp).
+         */
+        std::string result_line(const Job& job, const JobResult& result) {
+            std::string line = "{\"job\":" + std::to_string(job.number) + ",\"status\":" + std::to_string(result.status);
+            char numbers[160];
+            if (result.usage) {
+                snprintf(numbers, sizeof(numbers), ",\"wall_time\":%.6f,\"user_time\":%.6f,\"system_time\":%.6f,\"max_rss_kb\":%ld",
+                        result.wall_time, seconds(result.usage->ru_utime), seconds(result.usage->ru_stime),
+                        result.usage->ru_maxrss);
+            } else {
+                snprintf(numbers, sizeof(numbers), ",\"wall_time\":%.6f", result.wall_time);
+            }
+            line += numbers;
+            line += ",\"log\":";
+            append_json_string(line, result.log);
+            line += "}\n";
+            return line;
+        }
+
+        std::string read_log(const int fd) {
+            std::string log;
+            if (lseek(fd, 0, SEEK_SET) != 0) {
+                return log;
+            }
+            char buffer[4096];
+            ssize_t size;
+            while ((size = read(fd, buffer, sizeof(buffer))) > 0) {
+                log.append(buffer, static_cast<size_t>(size));
+            }
+            return log;
+        }
+
+        /**
+         * Runs queued jobs in forked processes, at most as many at once as their threads fit
+         * into the number of workers. A job using more threads than there are workers runs alone.
+         */
+        class JobPool {
+
+            using finished_function = std::function<void(const Job&, const JobResult&)>;
+
+            const job_function& m_run_job;
+
+            const int m_workers;
+
+            /// called with the result of every job
+            finished_function m_finished;
+
+            /// called in the forked process before the job runs to close file descriptors of the parent
+            std::function<void()> m_child_cleanup;
+
+            std::string m_temp_directory;
+
+            std::deque<Job> m_queue;
+
+            std::map<pid_t, RunningJob> m_running;
+
+            int m_threads_running = 0;
+
+            /**
+             * Code of the forked process of a job, never returns.
+             */
+            void run_child(const Job& job, const int log_fd) {
+                signal(SIGCHLD, SIG_DFL);
+                signal(SIGINT, SIG_DFL);
+                signal(SIGTERM, SIG_DFL);
+                signal(SIGPIPE, SIG_DFL);
+                m_child_cleanup();
+                dup2(log_fd, STDOUT_FILENO);
+                dup2(log_fd, STDERR_FILENO);
+                close(log_fd);
+                const int status = m_run_job(job.arguments);
+                std::cout.flush();
+                exit(status);
+            }
+
+            void start_job(Job&& job) {
+                std::string log_name = m_temp_directory + "/linestringssplitter-job-XXXXXX";
+                const int log_fd = mkstemp(&log_name[0]);
+                if (log_fd < 0) {
+                    m_finished(job, JobResult{1, 0.0, nullptr, "ERROR: failed to create a temporary file in "
+                            + m_temp_directory + ": " + std::strerror(errno) + "\n"});
+                    return;
+                }
+                unlink(log_name.c_str());
+                // Output buffered in the parent would be written by the child again.
+                std::cout.flush();
+                const auto start = std::chrono::steady_clock::now();
+                const pid_t pid = fork();
+                if (pid < 0) {
+                    close(log_fd);
+                    m_finished(job, JobResult{1, 0.0, nullptr, std::string{"ERROR: fork failed: "} + std::strerror(errno) + "\n"});
+                    return;
+                }
+                if (pid == 0) {
+                    run_child(job, log_fd);
+                }
+                m_threads_running += job.threads;
+                m_running.emplace(pid, RunningJob{std::move(job), start, log_fd});
+            }
+
+            void finish(const pid_t pid, const int status, const rusage& usage) {
+                auto it = m_running.find(pid);
+                if (it == m_running.end()) {
+                    return;
+                }
+                const std::chrono::duration<double> wall_time = std::chrono::steady_clock::now() - it->second.start;
+                const std::string log = read_log(it->second.log_fd);
+                close(it->second.log_fd);
+                // exit status like a shell reports it
+                const int exit_status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+                m_threads_running -= it->second.job.threads;
+                const Job job = std::move(it->second.job);
+                m_running.erase(it);
+                m_finished(job, JobResult{exit_status, wall_time.count(), &usage, log});
+            }
+
+        public:
+
+            JobPool(const job_function& run_job, const int workers, finished_function&& finished,
+                    std::function<void()>&& child_cleanup) :
+                m_run_job(run_job),
+                m_workers(workers),
+                m_finished(std::move(finished)),
+                m_child_cleanup(std::move(child_cleanup)),
+                m_temp_directory("/tmp"),
+                m_queue(),
+                m_running() {
+                const char* tmpdir = std::getenv("TMPDIR");
+                if (tmpdir) {
+                    m_temp_directory = tmpdir;
+                }
+            }
+
+            void add(Job&& job) {
+                m_queue.push_back(std::move(job));
+            }
+
+            void start_jobs() {
+                while (!m_queue.empty()
+                        && (m_running.empty() || m_threads_running + m_queue.front().threads <= m_workers)) {
+                    Job job = std::move(m_queue.front());
+                    m_queue.pop_front();
+                    start_job(std::move(job));
+                }
+            }
+
+            /**
+             * Collect the results of finished jobs.
+             *
+             * \param block wait until at least one job has finished
+             */
+            void reap(const bool block) {
+                int status;
+                rusage usage;
+                pid_t pid;
+                if (block && !m_running.empty()) {
+                    while ((pid = wait4(-1, &status, 0, &usage)) < 0 && errno == EINTR) {
+                    }
+                    if (pid > 0) {
+                        finish(pid, status, usage);
+                    }
+                }
+                while ((pid = wait4(-1, &status, WNOHANG, &usage)) > 0) {
+                    finish(pid, status, usage);
+                }
+            }
+
+            /**
+             * Report all jobs which have not been started yet as failed.
+             */
+            void cancel_queued(const std::string& message) {
+                while (!m_queue.empty()) {
+                    const Job job = std::move(m_queue.front());
+                    m_queue.pop_front();
+                    m_finished(job, JobResult{1, 0.0, nullptr, message});
+                }
+            }
+
+            bool running() const noexcept {
+                return !m_running.empty();
+            }
+
+            bool idle() const noexcept {
+                return m_queue.empty() && m_running.empty();
+            }
+
+        }; // class JobPool
+
+        class Server {
+
+            const int m_workers;
+
+            int m_listen_fd = -1;
+
+            uint64_t m_next_client_id = 0;
+
+            std::map<uint64_t, Client> m_clients;
+
+            JobPool m_pool;
+
+            void send_line(const uint64_t client_id, const std::string& line) {
+                auto it = m_clients.find(client_id);
+                if (it == m_clients.end()) {
+                    return;
+                }
+                size_t written = 0;
+                while (written < line.size()) {
+                    const ssize_t size = send(it->second.fd, line.data() + written, line.size() - written, MSG_NOSIGNAL);
+                    if (size < 0 && errno == EINTR) {
+                        continue;
+                    }
+                    if (size <= 0) {
+                        // The client is gone, its remaining results are discarded.
+                        it->second.input_closed = true;
+                        return;
+                    }
+                    written += static_cast<size_t>(size);
+                }
+            }
+
+            void send_result(const Job& job, const JobResult& result) {
+                send_line(job.client_id, result_line(job, result));
+                auto it = m_clients.find(job.client_id);
+                if (it != m_clients.end()) {
+                    --it->second.pending;
+                }
+            }
+
+            void close_parent_fds() {
+                close(m_listen_fd);
+                close(signal_pipe[0]);
+                close(signal_pipe[1]);
+                for (const auto& client : m_clients) {
+                    close(client.second.fd);
+                }
+            }
+
+            void listen_on(const std::string& socket_path) {
+                sockaddr_un address;
+                std::memset(&address, 0, sizeof(address));
+                address.sun_family = AF_UNIX;
+                if (socket_path.size() >= sizeof(address.sun_path)) {
+                    std::cerr << "ERROR: socket path " << socket_path << " is too long\n";
+                    exit(1);
+                }
+                std::strcpy(address.sun_path, socket_path.c_str());
+                // remove the socket of a server which did not shut down cleanly
+                struct stat info;
+                if (stat(socket_path.c_str(), &info) == 0 && S_ISSOCK(info.st_mode)) {
+                    unlink(socket_path.c_str());
+                }
+                m_listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+                if (m_listen_fd < 0 || bind(m_listen_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+                        || listen(m_listen_fd, SOMAXCONN) != 0) {
+                    std::cerr << "ERROR: failed to listen on " << socket_path << ": " << std::strerror(errno) << '\n';
+                    exit(1);
+                }
+            }
+
+            void install_signal_handlers() {
+                if (pipe(signal_pipe) != 0) {
+                    std::cerr << "ERROR: failed to create a pipe: " << std::strerror(errno) << '\n';
+                    exit(1);
+                }
+                for (const int fd : signal_pipe) {
+                    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+                    fcntl(fd, F_SETFD, FD_CLOEXEC);
+                }
+                struct sigaction action;
+                std::memset(&action, 0, sizeof(action));
+                action.sa_handler = handle_signal;
+                sigemptyset(&action.sa_mask);
+                action.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+                sigaction(SIGCHLD, &action, nullptr);
+                sigaction(SIGINT, &action, nullptr);
+                sigaction(SIGTERM, &action, nullptr);
+                signal(SIGPIPE, SIG_IGN);
+            }
+
+            void accept_client() {
+                const int fd = accept(m_listen_fd, nullptr, nullptr);
+                if (fd < 0) {
+                    return;
+                }
+                fcntl(fd, F_SETFD, FD_CLOEXEC);
+                Client client;
+                client.fd = fd;
+                m_clients.emplace(m_next_client_id++, std::move(client));
+            }
+
+            void read_client(const uint64_t client_id, Client& client) {
+                char buffer[4096];
+                const ssize_t size = read(client.fd, buffer, sizeof(buffer));
+                if (size <= 0) {
+                    if (size == 0 || errno != EINTR) {
+                        client.input_closed = true;
+                    }
+                    return;
+                }
+                client.buffer.append(buffer, static_cast<size_t>(size));
+                size_t newline;
+                while ((newline = client.buffer.find('\n')) != std::string::npos) {
+                    std::string line = client.buffer.substr(0, newline);
+                    client.buffer.erase(0, newline + 1);
+                    if (!line.empty() && line.back() == '\r') {
+                        line.pop_back();
+                    }
+                    if (line.empty()) {
+                        continue;
+                    }
+                    Job job;
+                    job.client_id = client_id;
+                    job.number = ++client.job_count;
+                    size_t begin = 0;
+                    size_t tab;
+                    while ((tab = line.find('\t', begin)) != std::string::npos) {
+                        job.arguments.push_back(line.substr(begin, tab - begin));
+                        begin = tab + 1;
+                    }
+                    job.arguments.push_back(line.substr(begin));
+                    ++client.pending;
+                    m_pool.add(std::move(job));
+                }
+            }
+
+            void close_finished_clients() {
+                for (auto it = m_clients.begin(); it != m_clients.end(); ) {
+                    if (it->second.input_closed && it->second.pending == 0) {
+                        close(it->second.fd);
+                        it = m_clients.erase(it);
+                    } else {
+                        ++it;
+                    }
+                }
+            }
+
+        public:
+
+            Server(const job_function& run_job, const int workers) :
+                m_workers(workers),
+                m_clients(),
+                m_pool(run_job, workers,
+                    [this](const Job& job, const JobResult& result) {
+                        send_result(job, result);
+                    },
+                    [this]() {
+                        close_parent_fds();
+                    }) {
+            }
+
+            int run(const std::string& socket_path) {
+                install_signal_handlers();
+                listen_on(socket_path);
+                std::cerr << "Listening on " << socket_path << ", running up to " << m_workers << " jobs at once.\n";
+                std::vector<pollfd> fds;
+                std::vector<uint64_t> fd_clients;
+                while (true) {
+                    m_pool.reap(false);
+                    if (stop_requested) {
+                        m_pool.cancel_queued("ERROR: the server is shutting down\n");
+                    }
+                    m_pool.start_jobs();
+                    close_finished_clients();
+                    if (stop_requested && !m_pool.running()) {
+                        break;
+                    }
+                    fds.clear();
+                    fd_clients.clear();
+                    fds.push_back(pollfd{signal_pipe[0], POLLIN, 0});
+                    if (!stop_requested) {
+                        fds.push_back(pollfd{m_listen_fd, POLLIN, 0});
+                        for (const auto& client : m_clients) {
+                            if (!client.second.input_closed) {
+                                fds.push_back(pollfd{client.second.fd, POLLIN, 0});
+                                fd_clients.push_back(client.first);
+                            }
+                        }
+                    }
+                    if (poll(fds.data(), fds.size(), -1) < 0) {
+                        if (errno == EINTR) {
+                            continue;
+                        }
+                        std::cerr << "ERROR: poll failed: " << std::strerror(errno) << '\n';
+                        exit(1);
+                    }
+                    if (fds[0].revents & POLLIN) {
+                        char buffer[64];
+                        while (read(signal_pipe[0], buffer, sizeof(buffer)) > 0) {
+                        }
+                    }
+                    if (fds.size() > 1 && (fds[1].revents & POLLIN)) {
+                        accept_client();
+                    }
+                    for (size_t i = 2; i < fds.size(); ++i) {
+                        if (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+                            auto it = m_clients.find(fd_clients[i - 2]);
+                            if (it != m_clients.end()) {
+                                read_client(it->first, it->second);
+                            }
+                        }
+                    }
+                }
+                for (const auto& client : m_clients) {
+                    close(client.second.fd);
+                }
+                close(m_listen_fd);
+                unlink(socket_path.c_str());
+                std::cerr << "Server stopped.\n";
+                return 0;
+            }
+
+        }; // class Server
+
+    } // anonymous namespace
+
+    int serve(const std::string& socket_path, const int workers, const job_function& run_job) {
+        Server server {run_job, workers};
+        return server.run(socket_path);
+    }
+
+    int run_batch(const std::vector<BatchJob>& jobs, const int workers, const job_function& run_job) {
+        size_t failed = 0;
+        JobPool pool {run_job, workers,
+            [&failed](const Job& job, const JobResult& result) {
+                if (result.status != 0) {
+                    ++failed;
+                }
+                std::cout << result_line(job, result) << std::flush;
+            },
+            []() {}};
+        int number = 0;
+        for (const BatchJob& batch_job : jobs) {
+            Job job;
+            job.client_id = 0;
+            job.number = ++number;
+            job.arguments = batch_job.arguments;
+            job.threads = batch_job.threads;
+            pool.add(std::move(job));
+        }
+        while (!pool.idle()) {
+            pool.start_jobs();
+            pool.reap(true);
+        }
+        std::cerr << jobs.size() << " jobs finished, " << failed << " failed.\n";
+        return failed == 0 ? 0 : 1;
+    }
+
+} // namespace server
@@ -0,0 +1,80 @@
+/*
+ *  © 2018 Geofabrik GmbH
+ *
+ *  This file is part of LinestringsSplitter.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef SERVER_HPP_
+#define SERVER_HPP_
+
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * Daemon mode (--serve): a warm process listening on a Unix socket which runs jobs sent by
+ * clients.
+ *
+ * Protocol: a client sends one job per line, the command line arguments of the job (options,
+ * INFILE, OUTFILE) separated by tab characters. For every job the server sends back one line
+ * with a JSON object when the job has finished:
+ *
+ *     {"job":1,"status":0,"wall_time":0.012,"user_time":0.008,"system_time":0.002,"max_rss_kb":14336,"log":""}
+ *
+ * job is the number of the job on its connection (starting at 1), status is the exit status of
+ * the job and log contains everything the job wrote to stdout and stderr. The lines of jobs
+ * running in parallel can arrive in any order.
+ *
+ * Every job runs in a process forked from the server, i.e. the GDAL drivers are registered
+ * only once and a failing job does not affect the server or other jobs.
+ *
+ * The batch mode (--manifest) runs a fixed list of jobs the same way and writes the result lines
+ * to stdout.
+ */
+namespace server {
+
+    /**
+     * Function running a job with the given command line arguments, returns the exit status.
+     */
+    using job_function = std::function<int(const std::vector<std::string>& arguments)>;
+
+    /**
+     * Serve jobs until the process receives SIGINT or SIGTERM.
+     *
+     * \param socket_path path of the Unix socket to listen on
+     * \param workers maximum number of jobs running at the same time
+     * \returns exit status of the server
+     */
+    int serve(const std::string& socket_path, const int workers, const job_function& run_job);
+
+    struct BatchJob {
+        std::vector<std::string> arguments;
+
+        /// threads used by the job, counted against the workers of the batch
+        int threads;
+    };
+
+    /**
+     * Run a batch of jobs, as many at once as their threads fit into the workers.
+     *
+     * \returns 0 if all jobs succeeded, 1 otherwise
+     */
+    int run_batch(const std::vector<BatchJob>& jobs, const int workers, const job_function& run_job);
+
+} // namespace server
+
+#endif /* SERVER_HPP_ */
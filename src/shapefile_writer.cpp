@@ -0,0 +1,660 @@
+/*
+ *  © 2018 Geofabrik GmbH
+ *
+ *  This file is part of LinestringsSplitter.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "shapefile_writer.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+
+#include <strings.h>
+
+#include <gdal/cpl_conv.h>
+
+#include "part_record.hpp"
+#include "stats.hpp"
+
+namespace {
+
+    /// maximum width of a .dbf field
+    constexpr int MAX_FIELD_WIDTH = 254;
+
+    void append_int32_be(std::string& buffer, const int32_t value) {
+        const uint32_t v = static_cast<uint32_t>(value);
+        const char bytes[4] = {static_cast<char>(v >> 24), static_cast<char>(v >> 16), static_cast<char>(v >> 8),
+                static_cast<char>(v)};
+        buffer.append(bytes, 4);
+    }
+
+    /// little endian, the byte order of the machine (checked in the constructor)
+    template <typename T>
+    void append_le(std::string& buffer, const T value) {
+        buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    bool ends_with_shp(const std::string& filename) {
+        if (filename.size() < 4) {
+            return false;
+        }
+        std::string extension = filename.substr(filename.size() - 4);
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+        return extension == ".shp";
+    }
+
+    template <typename T>
+    T read_le(const unsigned char* data) noexcept {
+        T value;
+        std::memcpy(&value, data, sizeof(T));
+        return value;
+    }
+
+    std::string xml_escape(const std::string& str) {
+        std::string result;
+        for (const char c : str) {
+            switch (c) {
+            case '&':
+                result += "&amp;";
+                break;
+            case '<':
+                result += "&lt;";
+                break;
+            case '>':
+                result += "&gt;";
+                break;
+            case '"':
+                result += "&quot;";
+                break;
+            default:
+                result += c;
+                break;
+            }
+        }
+        return result;
+    }
+
+    /**
+     * Copy at most max_size bytes of a UTF-8 string without cutting a character in half.
+     */
+    size_t utf8_prefix_size(const char* str, const size_t max_size) {
+        size_t size = std::strlen(str);
+        if (size <= max_size) {
+            return size;
+        }
+        size = max_size;
+        while (size > 0 && (static_cast<unsigned char>(str[size]) & 0xc0) == 0x80) {
+            --size;
+        }
+        return size;
+    }
+
+} // anonymous namespace
+
+ShapefileWriter::ShapefileWriter(const std::string& filename, OGRLayer* input_layer, Options& options) :
+    Writer(input_layer, options),
+    m_output_basename(filename.substr(0, filename.size() - 4)),
+    m_basename(m_output_basename),
+    m_pieces(),
+    m_shp(nullptr),
+    m_shx(nullptr),
+    m_dbf(nullptr),
+    m_fields(),
+    m_source_record(),
+    m_prj(),
+    m_encoding(),
+    m_points(),
+    m_shape(),
+    m_row() {
+    const uint32_t one = 1;
+    if (*reinterpret_cast<const unsigned char*>(&one) != 1) {
+        std::cerr << "ERROR: the native shapefile writer is only supported on little endian machines.\n";
+        exit(1);
+    }
+    create_fields(input_layer->GetLayerDefn());
+    open_source_dbf();
+    read_encoding();
+    read_prj(input_layer);
+    open_files();
+}
+
+ShapefileWriter::~ShapefileWriter() {
+    stop_thread();
+    close_files();
+    if (m_source_dbf) {
+        std::fclose(m_source_dbf);
+    }
+}
+
+/*static*/ bool ShapefileWriter::supports(const std::string& filename, const Options& options) {
+    // Creation options are specific to the OGR driver.
+    return options.output_format == "ESRI Shapefile" && ends_with_shp(filename)
+        && !options.dataset_creation_options && !options.layer_creation_options;
+}
+
+void ShapefileWriter::open_files() {
+    m_pieces.push_back(m_basename);
+    m_shp = open_file(".shp");
+    m_shx = open_file(".shx");
+    m_dbf = open_file(".dbf");
+    // placeholders, finalize() writes the real headers
+    const std::string shp_placeholder = shp_header(SHP_HEADER_SIZE);
+    write_bytes(m_shp, ".shp", shp_placeholder.data(), shp_placeholder.size());
+    write_bytes(m_shx, ".shx", shp_placeholder.data(), shp_placeholder.size());
+    const std::string dbf_placeholder = dbf_header();
+    write_bytes(m_dbf, ".dbf", dbf_placeholder.data(), dbf_placeholder.size());
+    if (!m_prj.empty()) {
+        std::FILE* prj = open_file(".prj");
+        write_bytes(prj, ".prj", m_prj.data(), m_prj.size());
+        std::fclose(prj);
+    }
+    if (!m_encoding.empty()) {
+        std::FILE* cpg = open_file(".cpg");
+        write_bytes(cpg, ".cpg", m_encoding.data(), m_encoding.size());
+        std::fclose(cpg);
+    }
+}
+
+bool ShapefileWriter::file_full(const size_t shape_size) const noexcept {
+    // a record larger than the limit gets a file of its own
+    if (m_record_count == 0) {
+        return false;
+    }
+    if (m_options.max_file_features > 0 && m_record_count >= m_options.max_file_features) {
+        return true;
+    }
+    // The .shx file is always smaller than the .shp file.
+    const size_t dbf_size = 32 + 32 * m_fields.size() + 1 + static_cast<size_t>(m_record_count + 1)
+        * static_cast<size_t>(m_record_length) + 1;
+    return m_shp_size + shape_size > m_options.max_file_size || dbf_size > m_options.max_file_size;
+}
+
+void ShapefileWriter::next_file() {
+    write_headers();
+    close_files();
+    char suffix[16];
+    snprintf(suffix, sizeof(suffix), "_%04d", static_cast<int>(m_pieces.size()));
+    m_basename = m_output_basename + suffix;
+    m_shp_size = SHP_HEADER_SIZE;
+    m_record_count = 0;
+    open_files();
+}
+
+void ShapefileWriter::write_vrt() const {
+    // The layer of a shapefile is named after the file.
+    const auto layer_name = [](const std::string& basename) {
+        const size_t slash = basename.find_last_of('/');
+        return slash == std::string::npos ? basename : basename.substr(slash + 1);
+    };
+    std::string vrt = "<OGRVRTDataSource>\n  <OGRVRTUnionLayer name=\"" + xml_escape(layer_name(m_output_basename))
+        + "\">\n";
+    for (const std::string& piece : m_pieces) {
+        const std::string name = xml_escape(layer_name(piece));
+        vrt += "    <OGRVRTLayer name=\"" + name + "\">\n      <SrcDataSource relativeToVRT=\"1\">" + name
+            + ".shp</SrcDataSource>\n    </OGRVRTLayer>\n";
+    }
+    vrt += "  </OGRVRTUnionLayer>\n</OGRVRTDataSource>\n";
+    const std::string filename = m_output_basename + ".vrt";
+    std::FILE* file = std::fopen(filename.c_str(), "wb");
+    if (!file || std::fwrite(vrt.data(), vrt.size(), 1, file) != 1 || std::fclose(file) != 0) {
+        std::cerr << "ERROR: writing " << filename << " failed: " << std::strerror(errno) << '\n';
+        exit(1);
+    }
+}
+
+std::FILE* ShapefileWriter::open_file(const std::string& extension) {
+    const std::string filename = m_basename + extension;
+    std::FILE* file = std::fopen(filename.c_str(), "wb");
+    if (!file) {
+        std::cerr << "ERROR: failed to open " << filename << ": " << std::strerror(errno) << '\n';
+        exit(1);
+    }
+    std::setvbuf(file, nullptr, _IOFBF, BUFFER_SIZE);
+    return file;
+}
+
+void ShapefileWriter::write_bytes(std::FILE* file, const std::string& extension, const void* data, const size_t size) {
+    if (size > 0 && std::fwrite(data, size, 1, file) != 1) {
+        std::cerr << "ERROR: writing to " << m_basename << extension << " failed: " << std::strerror(errno) << '\n';
+        exit(1);
+    }
+}
+
+void ShapefileWriter::add_field(const std::string& name, const char type, const int width, const int decimals,
+        const int input_index) {
+    // Names are limited to 10 bytes, make truncated names unique like the OGR driver does.
+    std::string unique_name = name.substr(0, 10);
+    for (int suffix = 1; ; ++suffix) {
+        const bool exists = std::any_of(m_fields.begin(), m_fields.end(), [&unique_name](const DbfField& field) {
+            return strcasecmp(field.name.c_str(), unique_name.c_str()) == 0;
+        });
+        if (!exists) {
+            break;
+        }
+        const std::string suffix_str = "_" + std::to_string(suffix);
+        unique_name = name.substr(0, 10 - suffix_str.size()) + suffix_str;
+    }
+    m_fields.push_back(DbfField{unique_name, type, std::min(width, MAX_FIELD_WIDTH), decimals, input_index});
+    m_record_length += m_fields.back().width;
+}
+
+void ShapefileWriter::create_fields(OGRFeatureDefn* input_defn) {
+    // widths and precisions used by the OGR driver if the input does not specify them
+    for (int i = 0; i < input_defn->GetFieldCount(); ++i) {
+        OGRFieldDefn* field_def = input_defn->GetFieldDefn(i);
+        const int width = field_def->GetWidth();
+        switch (field_def->GetType()) {
+        case OFTInteger:
+            add_field(field_def->GetNameRef(), 'N', width > 0 ? width : 9, 0, i);
+            break;
+        case OFTInteger64:
+            add_field(field_def->GetNameRef(), 'N', width > 0 ? width : 18, 0, i);
+            break;
+        case OFTReal:
+            if (width > 0) {
+                add_field(field_def->GetNameRef(), 'N', width, field_def->GetPrecision(), i);
+            } else {
+                add_field(field_def->GetNameRef(), 'N', 24, 15, i);
+            }
+            break;
+        case OFTString:
+            add_field(field_def->GetNameRef(), 'C', width > 0 ? width : 80, 0, i);
+            break;
+        case OFTDate:
+            add_field(field_def->GetNameRef(), 'D', 8, 0, i);
+            break;
+        case OFTDateTime:
+            add_field(field_def->GetNameRef(), 'C', 24, 0, i);
+            break;
+        default:
+            // written as their string representation
+            add_field(field_def->GetNameRef(), 'C', MAX_FIELD_WIDTH, 0, i);
+            break;
+        }
+    }
+    if (m_options.grid_size > 0) {
+        add_field("cell_x", 'N', 10, 0, -1);
+        add_field("cell_y", 'N', 10, 0, -2);
+    }
+    if (m_record_length > 65535) {
+        std::cerr << "ERROR: the fields of the input layer exceed the maximum record length of a .dbf file\n";
+        exit(1);
+    }
+}
+
+bool ShapefileWriter::open_source_dbf() {
+    const std::string& input_filename = m_options.input_filename;
+    if (!ends_with_shp(input_filename)) {
+        return false;
+    }
+    const std::string basename = input_filename.substr(0, input_filename.size() - 4);
+    std::FILE* file = std::fopen((basename + ".dbf").c_str(), "rb");
+    if (!file) {
+        file = std::fopen((basename + ".DBF").c_str(), "rb");
+    }
+    if (!file) {
+        return false;
+    }
+    unsigned char header[32];
+    std::vector<unsigned char> descriptors;
+    if (std::fread(header, sizeof(header), 1, file) == 1) {
+        m_source_header_size = read_le<uint16_t>(header + 8);
+        m_source_record_length = read_le<uint16_t>(header + 10);
+        m_language_driver = static_cast<char>(header[29]);
+        if (m_source_header_size > sizeof(header)) {
+            descriptors.resize(m_source_header_size - sizeof(header));
+            if (std::fread(descriptors.data(), descriptors.size(), 1, file) != 1) {
+                descriptors.clear();
+            }
+        }
+    }
+    // The fields of the input have to be the first fields of the output, in the same order and
+    // with the same name, type and size.
+    bool identical = !descriptors.empty();
+    size_t offset = 0;
+    int record_length = 1;
+    for (const DbfField& field : m_fields) {
+        if (!identical || field.input_index < 0) {
+            continue;
+        }
+        if (offset + 32 > descriptors.size() || descriptors[offset] == 0x0d) {
+            identical = false;
+            break;
+        }
+        const char* descriptor = reinterpret_cast<const char*>(descriptors.data() + offset);
+        const std::string name {descriptor, strnlen(descriptor, 11)};
+        identical = name == field.name && descriptor[11] == field.type
+            && static_cast<unsigned char>(descriptor[16]) == field.width
+            && static_cast<unsigned char>(descriptor[17]) == field.decimals;
+        record_length += field.width;
+        offset += 32;
+    }
+    identical = identical && offset < descriptors.size() && descriptors[offset] == 0x0d
+        && m_source_record_length == static_cast<size_t>(record_length);
+    if (!identical) {
+        std::fclose(file);
+        return false;
+    }
+    std::setvbuf(file, nullptr, _IOFBF, BUFFER_SIZE);
+    m_source_dbf = file;
+    return true;
+}
+
+const std::string& ShapefileWriter::source_record(const GIntBig fid) {
+    // all parts of a feature are written one after the other
+    if (fid == m_source_fid) {
+        return m_source_record;
+    }
+    if (fid < 0) {
+        std::cerr << "ERROR: invalid FID " << fid << " in " << m_options.input_filename << '\n';
+        exit(1);
+    }
+    // The FID of a feature of a shapefile is the number of its record. Features are usually
+    // read in the order of their FIDs, seeking is not necessary then.
+    if (fid != m_source_position
+            && std::fseek(m_source_dbf, static_cast<long>(m_source_header_size
+                    + static_cast<size_t>(fid) * m_source_record_length), SEEK_SET) != 0) {
+        std::cerr << "ERROR: seeking in the .dbf file of " << m_options.input_filename << " failed: "
+            << std::strerror(errno) << '\n';
+        exit(1);
+    }
+    m_source_record.resize(m_source_record_length);
+    if (std::fread(&m_source_record[0], m_source_record_length, 1, m_source_dbf) != 1) {
+        std::cerr << "ERROR: failed to read record " << fid << " from the .dbf file of "
+            << m_options.input_filename << '\n';
+        exit(1);
+    }
+    m_source_fid = fid;
+    m_source_position = fid + 1;
+    return m_source_record;
+}
+
+void ShapefileWriter::read_encoding() {
+    if (!m_source_dbf) {
+        m_encoding = "UTF-8";
+        return;
+    }
+    // The records keep the encoding of the input, it is declared by its .cpg file or the
+    // language driver ID.
+    const std::string& input_filename = m_options.input_filename;
+    std::FILE* source_cpg = std::fopen((input_filename.substr(0, input_filename.size() - 4) + ".cpg").c_str(), "rb");
+    if (!source_cpg) {
+        return;
+    }
+    char buffer[256];
+    m_encoding.assign(buffer, std::fread(buffer, 1, sizeof(buffer), source_cpg));
+    std::fclose(source_cpg);
+}
+
+void ShapefileWriter::read_prj(OGRLayer* input_layer) {
+    OGRSpatialReference* srs = input_layer->GetSpatialRef();
+    if (!srs) {
+        return;
+    }
+    OGRSpatialReference* esri_srs = srs->Clone();
+    char* wkt = nullptr;
+    if (esri_srs->morphToESRI() == OGRERR_NONE && esri_srs->exportToWkt(&wkt) == OGRERR_NONE) {
+        m_prj = wkt;
+    }
+    CPLFree(wkt);
+    esri_srs->Release();
+}
+
+std::string ShapefileWriter::shp_header(const size_t file_size) const {
+    std::string header;
+    append_int32_be(header, 9994);
+    for (int i = 0; i < 5; ++i) {
+        append_int32_be(header, 0);
+    }
+    // length in 16 bit words
+    append_int32_be(header, static_cast<int32_t>(file_size / 2));
+    append_le<int32_t>(header, 1000);
+    append_le<int32_t>(header, SHAPE_TYPE);
+    append_le(header, m_min_x);
+    append_le(header, m_min_y);
+    append_le(header, m_max_x);
+    append_le(header, m_max_y);
+    // Z and M ranges
+    for (int i = 0; i < 4; ++i) {
+        append_le(header, 0.0);
+    }
+    return header;
+}
+
+std::string ShapefileWriter::dbf_header() const {
+    std::string header;
+    const std::time_t now = std::time(nullptr);
+    // shards are finalized concurrently, std::localtime() is not thread-safe
+    std::tm date;
+    localtime_r(&now, &date);
+    header += '\x03';
+    header += static_cast<char>(date.tm_year % 100);
+    header += static_cast<char>(date.tm_mon + 1);
+    header += static_cast<char>(date.tm_mday);
+    append_le<uint32_t>(header, static_cast<uint32_t>(m_record_count));
+    append_le<uint16_t>(header, static_cast<uint16_t>(32 + 32 * m_fields.size() + 1));
+    append_le<uint16_t>(header, static_cast<uint16_t>(m_record_length));
+    header.append(17, '\0');
+    header += m_language_driver;
+    header.append(2, '\0');
+    for (const DbfField& field : m_fields) {
+        std::string descriptor {field.name};
+        descriptor.resize(11, '\0');
+        descriptor += field.type;
+        descriptor.append(4, '\0');
+        descriptor += static_cast<char>(field.width);
+        descriptor += static_cast<char>(field.decimals);
+        descriptor.append(14, '\0');
+        header += descriptor;
+    }
+    header += '\x0d';
+    return header;
+}
+
+void ShapefileWriter::append_value(const DbfField& field, OGRFeature* feature, const GridCell* cell) {
+    const size_t start = m_row.size();
+    const size_t width = static_cast<size_t>(field.width);
+    // large enough for any number which fits into a field
+    char buffer[MAX_FIELD_WIDTH + 64];
+    int size = 0;
+    if (field.input_index < 0) {
+        size = snprintf(buffer, sizeof(buffer), "%*d", field.width, field.input_index == -1 ? cell->x : cell->y);
+#if GDAL_VERSION_NUM >= 2020000
+    } else if (!feature->IsFieldSetAndNotNull(field.input_index)) {
+#else
+    } else if (!feature->IsFieldSet(field.input_index)) {
+#endif
+        // null values as written by shapelib
+        m_row.append(width, field.type == 'N' ? '*' : (field.type == 'D' ? '0' : ' '));
+        return;
+    } else {
+        const OGRField* value = feature->GetRawFieldRef(field.input_index);
+        switch (m_input_defn->GetFieldDefn(field.input_index)->GetType()) {
+        case OFTInteger:
+            size = snprintf(buffer, sizeof(buffer), "%*d", field.width, value->Integer);
+            break;
+        case OFTInteger64:
+            size = snprintf(buffer, sizeof(buffer), "%*lld", field.width, static_cast<long long>(value->Integer64));
+            break;
+        case OFTReal:
+            size = snprintf(buffer, sizeof(buffer), "%*.*f", field.width, field.decimals, value->Real);
+            break;
+        case OFTDate:
+            size = snprintf(buffer, sizeof(buffer), "%04d%02d%02d", value->Date.Year, value->Date.Month, value->Date.Day);
+            break;
+        case OFTString:
+            m_row.append(value->String, utf8_prefix_size(value->String, width));
+            break;
+        default: {
+                const char* str = feature->GetFieldAsString(field.input_index);
+                m_row.append(str, utf8_prefix_size(str, width));
+            }
+            break;
+        }
+    }
+    if (size > 0) {
+        if (static_cast<size_t>(size) > width) {
+            // does not fit into the field
+            m_row.append(width, '*');
+            return;
+        }
+        m_row.append(buffer, static_cast<size_t>(size));
+    }
+    m_row.resize(start + width, ' ');
+}
+
+void ShapefileWriter::write_part(const double* x_coords, const double* y_coords, const int count, OGRFeature* feature,
+        const GridCell* cell) {
+    set_points(x_coords, y_coords, count);
+    write_shape(m_points.data(), count, feature->GetFID(), feature, cell);
+}
+
+void ShapefileWriter::write_linestring(OGRLineString* linestring, OGRFeature* feature) {
+    const int count = linestring->getNumPoints();
+    m_points.resize(static_cast<size_t>(count));
+    linestring->getPoints(m_points.data());
+    write_shape(m_points.data(), count, feature->GetFID(), feature, nullptr);
+}
+
+void ShapefileWriter::set_points(const double* x_coords, const double* y_coords, const int count) {
+    m_points.resize(static_cast<size_t>(count));
+    for (int i = 0; i < count; ++i) {
+        m_points[static_cast<size_t>(i)].x = x_coords[i];
+        m_points[static_cast<size_t>(i)].y = y_coords[i];
+    }
+}
+
+void ShapefileWriter::write_record(const std::string& record) {
+    if (!m_source_dbf) {
+        Writer::write_record(record);
+        return;
+    }
+    const part_record::View view = part_record::decode(record);
+    part_record::read_coordinates(view, m_x_coords, m_y_coords);
+    const int count = static_cast<int>(view.count);
+    set_points(m_x_coords.data(), m_y_coords.data(), count);
+    write_shape(m_points.data(), count, view.fid, nullptr, view.has_cell ? &view.cell : nullptr);
+}
+
+void ShapefileWriter::write_shape(const OGRRawPoint* points, const int count, const GIntBig fid, OGRFeature* feature,
+        const GridCell* cell) {
+    {
+        stats::StageScope stage {stats::Stage::fields};
+        if (m_source_dbf) {
+            m_row = source_record(fid);
+        } else {
+            m_row.clear();
+            // not deleted
+            m_row += ' ';
+        }
+        for (const DbfField& field : m_fields) {
+            // the fields of the input are part of the copied record
+            if (!m_source_dbf || field.input_index < 0) {
+                append_value(field, feature, cell);
+            }
+        }
+    }
+    double min_x = points[0].x;
+    double max_x = points[0].x;
+    double min_y = points[0].y;
+    double max_y = points[0].y;
+    for (int i = 1; i < count; ++i) {
+        min_x = std::min(min_x, points[i].x);
+        max_x = std::max(max_x, points[i].x);
+        min_y = std::min(min_y, points[i].y);
+        max_y = std::max(max_y, points[i].y);
+    }
+    // shape type, bounding box, number of parts and points, index of the first point of the only part
+    const int32_t content_size = 4 + 32 + 4 + 4 + 4 + 16 * count;
+    if (file_full(8 + static_cast<size_t>(content_size))) {
+        next_file();
+    }
+    if (m_record_count == 0) {
+        m_min_x = min_x;
+        m_max_x = max_x;
+        m_min_y = min_y;
+        m_max_y = max_y;
+    } else {
+        m_min_x = std::min(m_min_x, min_x);
+        m_max_x = std::max(m_max_x, max_x);
+        m_min_y = std::min(m_min_y, min_y);
+        m_max_y = std::max(m_max_y, max_y);
+    }
+    m_shape.clear();
+    append_int32_be(m_shape, m_record_count + 1);
+    append_int32_be(m_shape, content_size / 2);
+    append_le<int32_t>(m_shape, SHAPE_TYPE);
+    append_le(m_shape, min_x);
+    append_le(m_shape, min_y);
+    append_le(m_shape, max_x);
+    append_le(m_shape, max_y);
+    append_le<int32_t>(m_shape, 1);
+    append_le<int32_t>(m_shape, count);
+    append_le<int32_t>(m_shape, 0);
+    // OGRRawPoint has the layout of a point in the file
+    static_assert(sizeof(OGRRawPoint) == 2 * sizeof(double), "OGRRawPoint must consist of two doubles");
+    m_shape.append(reinterpret_cast<const char*>(points), static_cast<size_t>(count) * sizeof(OGRRawPoint));
+    std::string index_entry;
+    append_int32_be(index_entry, static_cast<int32_t>(m_shp_size / 2));
+    append_int32_be(index_entry, content_size / 2);
+    write_bytes(m_shp, ".shp", m_shape.data(), m_shape.size());
+    write_bytes(m_shx, ".shx", index_entry.data(), index_entry.size());
+    write_bytes(m_dbf, ".dbf", m_row.data(), m_row.size());
+    m_shp_size += m_shape.size();
+    ++m_record_count;
+}
+
+void ShapefileWriter::write_headers() {
+    const std::string shp = shp_header(m_shp_size);
+    const std::string shx = shp_header(SHP_HEADER_SIZE + 8 * static_cast<size_t>(m_record_count));
+    const std::string dbf = dbf_header();
+    std::rewind(m_shp);
+    write_bytes(m_shp, ".shp", shp.data(), shp.size());
+    std::rewind(m_shx);
+    write_bytes(m_shx, ".shx", shx.data(), shx.size());
+    // the end of file marker is not part of the header
+    if (std::fseek(m_dbf, 0, SEEK_END) != 0) {
+        std::cerr << "ERROR: seeking in " << m_basename << ".dbf failed: " << std::strerror(errno) << '\n';
+        exit(1);
+    }
+    write_bytes(m_dbf, ".dbf", "\x1a", 1);
+    std::rewind(m_dbf);
+    write_bytes(m_dbf, ".dbf", dbf.data(), dbf.size());
+}
+
+void ShapefileWriter::close_files() {
+    for (std::FILE** file : {&m_shp, &m_shx, &m_dbf}) {
+        if (*file && std::fclose(*file) != 0) {
+            std::cerr << "ERROR: closing " << m_basename << " failed: " << std::strerror(errno) << '\n';
+            exit(1);
+        }
+        *file = nullptr;
+    }
+}
+
+void ShapefileWriter::finalize() {
+    stop_thread();
+    write_headers();
+    close_files();
+    if (m_options.write_vrt) {
+        write_vrt();
+    }
+}
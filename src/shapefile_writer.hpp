@@ -0,0 +1,236 @@
+/*
+ *  © 2018 Geofabrik GmbH
+ *
+ *  This file is part of LinestringsSplitter.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef SHAPEFILE_WRITER_HPP_
+#define SHAPEFILE_WRITER_HPP_
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "writer.hpp"
+
+/**
+ * Writer for ESRI Shapefiles which writes the .shp, .shx and .dbf files directly instead of
+ * going through OGR. Records are appended using large buffered sequential writes, the headers
+ * (file lengths, bounding box, record count) are written again by finalize().
+ *
+ * Strings are written as UTF-8 and a .cpg file declares the encoding.
+ *
+ * If the input is a shapefile too and the fields of its .dbf file are identical to the fields
+ * of the output, the attributes are not encoded again. The record of the input feature is read
+ * from the input .dbf file and copied verbatim into every part (together with the encoding of
+ * the input file).
+ *
+ * If a file would exceed Options::max_file_size or Options::max_file_features, the writer
+ * continues with a new set of files with _0001, _0002, … appended to the name. A VRT file
+ * can combine them into one layer.
+ */
+class ShapefileWriter : public Writer {
+private:
+    /// size of the stdio buffers of the output files
+    static constexpr size_t BUFFER_SIZE = 4 * 1024 * 1024;
+
+    static constexpr int SHP_HEADER_SIZE = 100;
+
+    /// shape type PolyLine
+    static constexpr int SHAPE_TYPE = 3;
+
+    /**
+     * Field of the .dbf file.
+     */
+    struct DbfField {
+        std::string name;
+
+        /// C (character), N (numeric), D (date)
+        char type;
+
+        int width;
+
+        int decimals;
+
+        /// index of the field in the input layer, -1 for the grid cell fields
+        int input_index;
+    };
+
+    /// path of the .shp file without the extension
+    std::string m_output_basename;
+
+    /// path of the current file without the extension
+    std::string m_basename;
+
+    /// paths of all files written so far without the extension
+    std::vector<std::string> m_pieces;
+
+    std::FILE* m_shp;
+
+    std::FILE* m_shx;
+
+    std::FILE* m_dbf;
+
+    std::vector<DbfField> m_fields;
+
+    /// .dbf file of the input if its records are copied verbatim, otherwise null
+    std::FILE* m_source_dbf = nullptr;
+
+    /// size of the header and of a record of the input .dbf file
+    size_t m_source_header_size = 0;
+
+    size_t m_source_record_length = 0;
+
+    /// language driver ID of the input .dbf file
+    char m_language_driver = 0;
+
+    /// FID of the record in m_source_record, -1 if none was read yet
+    GIntBig m_source_fid = -1;
+
+    /// FID of the record at the current position in the input .dbf file
+    GIntBig m_source_position = 0;
+
+    std::string m_source_record;
+
+    /// content of the .prj file, empty if the input has no SRS
+    std::string m_prj;
+
+    /// content of the .cpg file, empty if none is written
+    std::string m_encoding;
+
+    /// length of a .dbf record including the deletion flag
+    int m_record_length = 1;
+
+    /// length of the .shp file in bytes
+    size_t m_shp_size = SHP_HEADER_SIZE;
+
+    int m_record_count = 0;
+
+    double m_min_x = 0.0;
+
+    double m_min_y = 0.0;
+
+    double m_max_x = 0.0;
+
+    double m_max_y = 0.0;
+
+    /// buffers for the record currently being built
+    std::vector<OGRRawPoint> m_points;
+
+    std::string m_shape;
+
+    std::string m_row;
+
+    /**
+     * Create the files of the current path and write their headers.
+     */
+    void open_files();
+
+    /**
+     * Check if adding a record with the given .shp size to the current file would exceed
+     * the limits.
+     */
+    bool file_full(const size_t shape_size) const noexcept;
+
+    /**
+     * Finish the current file and continue with the next one.
+     */
+    void next_file();
+
+    /**
+     * Write a VRT file with a union of the layers of all files.
+     */
+    void write_vrt() const;
+
+    std::FILE* open_file(const std::string& extension);
+
+    void write_bytes(std::FILE* file, const std::string& extension, const void* data, const size_t size);
+
+    void add_field(const std::string& name, const char type, const int width, const int decimals, const int input_index);
+
+    void create_fields(OGRFeatureDefn* input_defn);
+
+    /**
+     * Open the .dbf file of the input if its fields match the fields of the output.
+     *
+     * \returns true if the records of the input can be copied
+     */
+    bool open_source_dbf();
+
+    /**
+     * Read the record of an input feature from the input .dbf file (or reuse the last one).
+     */
+    const std::string& source_record(const GIntBig fid);
+
+    void read_encoding();
+
+    void read_prj(OGRLayer* input_layer);
+
+    std::string shp_header(const size_t file_size) const;
+
+    std::string dbf_header() const;
+
+    void append_value(const DbfField& field, OGRFeature* feature, const GridCell* cell);
+
+    /**
+     * Copy the coordinates into m_points, the layout of the points in a .shp file.
+     */
+    void set_points(const double* x_coords, const double* y_coords, const int count);
+
+    void write_shape(const OGRRawPoint* points, const int count, const GIntBig fid, OGRFeature* feature,
+            const GridCell* cell);
+
+    void write_headers();
+
+    void close_files();
+
+public:
+    /**
+     * \param filename path of the .shp file
+     */
+    ShapefileWriter(const std::string& filename, OGRLayer* input_layer, Options& options);
+
+    ~ShapefileWriter();
+
+    /**
+     * Check if the native writer can produce the output the options ask for. Otherwise the OGR
+     * driver has to be used.
+     */
+    static bool supports(const std::string& filename, const Options& options);
+
+    void write_part(const double* x_coords, const double* y_coords, const int count, OGRFeature* feature,
+            const GridCell* cell) override;
+
+    /**
+     * Write the points of the linestring without splitting them into coordinate arrays first.
+     */
+    void write_linestring(OGRLineString* linestring, OGRFeature* feature) override;
+
+    /**
+     * Write a serialized part. If the input records are copied, the packed attributes are not
+     * unpacked.
+     */
+    void write_record(const std::string& record) override;
+
+    bool needs_attributes() const noexcept override {
+        return !m_source_dbf;
+    }
+
+    void finalize() override;
+};
+
+#endif /* SHAPEFILE_WRITER_HPP_ */
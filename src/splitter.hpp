@@ -0,0 +1,194 @@
+/*
+ *  © 2018 Geofabrik GmbH
+ *
+ *  This file is part of LinestringsSplitter.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef SPLITTER_HPP_
+#define SPLITTER_HPP_
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+/**
+ * Splitting of linestrings by length, independent of GDAL.
+ *
+ * The functions work on views of coordinates owned by the caller and report the parts as ranges
+ * of vertex indexes. They do not allocate memory. A view is a PointView or any other type with
+ * the member functions size(), x(index) and y(index), e.g. one reading the vertices of a geometry
+ * object in place. The distance between two points is calculated
+ * by a policy object, see PlanarDistance and SphericalDistance.
+ */
+namespace splitter {
+
+    /**
+     * Euclidean distance in the units of the coordinates.
+     */
+    struct PlanarDistance {
+        double operator()(const double x1, const double y1, const double x2, const double y2) const noexcept {
+            return std::sqrt((x2 - x1) * (x2 - x1) + (y2 - y1) * (y2 - y1));
+        }
+    };
+
+    /**
+     * Approximate distance in meters between geographic coordinates (longitude, latitude in degrees).
+     */
+    struct SphericalDistance {
+        static constexpr double PI = 3.14159265358979323846;
+
+        static constexpr double EARTH_RADIUS_IN_METERS = 6372797.560856;
+
+        static constexpr double deg_to_rad(const double degree) noexcept {
+            return degree * (PI / 180.0);
+        }
+
+        double operator()(const double lon1, const double lat1, const double lon2, const double lat2) const noexcept {
+            const double dx = EARTH_RADIUS_IN_METERS * deg_to_rad(lon2 - lon1);
+            const double dy = EARTH_RADIUS_IN_METERS * deg_to_rad(lat2 - lat1);
+            return std::sqrt(dx * dx + dy * dy);
+        }
+    };
+
+    /**
+     * View of the vertices of a linestring, either as separate x and y arrays or as interleaved
+     * x/y pairs.
+     */
+    class PointView {
+        const double* m_x;
+
+        const double* m_y;
+
+        std::size_t m_size;
+
+        /// distance between two x (or y) coordinates in doubles
+        std::size_t m_stride;
+
+        PointView(const double* x, const double* y, const std::size_t size, const std::size_t stride) noexcept :
+            m_x(x),
+            m_y(y),
+            m_size(size),
+            m_stride(stride) {
+        }
+
+    public:
+        PointView(const double* x, const double* y, const std::size_t size) noexcept :
+            PointView(x, y, size, 1) {
+        }
+
+        /**
+         * \param xy size pairs of x and y coordinates
+         */
+        static PointView interleaved(const double* xy, const std::size_t size) noexcept {
+            return PointView{xy, xy + 1, size, 2};
+        }
+
+        std::size_t size() const noexcept {
+            return m_size;
+        }
+
+        /**
+         * View of size vertices starting at vertex first, e.g. one linestring of a batch.
+         */
+        PointView slice(const std::size_t first, const std::size_t size) const noexcept {
+            return PointView{m_x + first * m_stride, m_y + first * m_stride, size, m_stride};
+        }
+
+        double x(const std::size_t index) const noexcept {
+            return m_x[index * m_stride];
+        }
+
+        double y(const std::size_t index) const noexcept {
+            return m_y[index * m_stride];
+        }
+    };
+
+    /**
+     * Part of a linestring from vertex first to vertex last (inclusive). Consecutive parts share
+     * a vertex.
+     */
+    struct Range {
+        std::size_t first;
+
+        std::size_t last;
+
+        double length;
+    };
+
+    template <typename TPoints, typename TDistance>
+    double length(const TPoints& points, const TDistance& distance) noexcept {
+        double length = 0.0;
+        for (std::size_t i = 1; i < points.size(); ++i) {
+            length += distance(points.x(i - 1), points.y(i - 1), points.x(i), points.y(i));
+        }
+        return length;
+    }
+
+    /**
+     * Check if a linestring should be dropped because it is shorter than min_length. Closed rings
+     * with more than 5 vertices are always kept.
+     *
+     * The length of a linestring is at least the distance between its ends. Only if this bound
+     * is too short, the length is calculated.
+     *
+     * \param length set to the length of the linestring if it is dropped
+     */
+    template <typename TPoints, typename TDistance>
+    bool skip_ring(const TPoints& points, const double min_length, const TDistance& distance, double& length) noexcept {
+        const std::size_t size = points.size();
+        if (size > 5 && points.x(0) == points.x(size - 1) && points.y(0) == points.y(size - 1)) {
+            return false;
+        }
+        if (size > 1 && distance(points.x(0), points.y(0), points.x(size - 1), points.y(size - 1)) >= min_length) {
+            return false;
+        }
+        length = splitter::length(points, distance);
+        return length < min_length;
+    }
+
+    /**
+     * Split a linestring into parts. A part ends at the first vertex where its length exceeds
+     * max_length, i.e. parts are longer than max_length except for the last one.
+     *
+     * \param callback called with a Range for every part of at least two vertices
+     * \returns number of parts
+     */
+    template <typename TPoints, typename TDistance, typename TCallback>
+    std::size_t split(const TPoints& points, const double max_length, const TDistance& distance,
+            TCallback&& callback) {
+        std::size_t parts = 0;
+        std::size_t first = 0;
+        double length = 0.0;
+        for (std::size_t i = 1; i < points.size(); ++i) {
+            length += distance(points.x(i - 1), points.y(i - 1), points.x(i), points.y(i));
+            if (length > max_length) {
+                callback(Range{first, i, length});
+                ++parts;
+                first = i;
+                length = 0.0;
+            }
+        }
+        if (points.size() > first + 1) {
+            callback(Range{first, points.size() - 1, length});
+            ++parts;
+        }
+        return parts;
+    }
+
+} // namespace splitter
+
+#endif /* SPLITTER_HPP_ */
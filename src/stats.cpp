@@ -0,0 +1,260 @@
+/*
+ *  © 2018 Geofabrik GmbH
+ *
+ *  This file is part of LinestringsSplitter.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "stats.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <set>
+
+#include "memory.hpp"
+
+namespace stats {
+
+    bool enabled = false;
+
+    Startup startup;
+
+    namespace {
+
+        /**
+         * Threads which are still running and the totals of those which have exited.
+         */
+        struct Registry {
+            std::mutex mutex;
+
+            std::set<const ThreadStats*> threads;
+
+            Totals exited {};
+        };
+
+        Registry& registry() {
+            static Registry instance;
+            return instance;
+        }
+
+        void add(const ThreadStats& thread, Totals& totals) noexcept {
+            for (int i = 0; i < STAGE_COUNT; ++i) {
+                totals.time_ns[i] += thread.time_ns[i];
+            }
+            for (int i = 0; i < COUNTER_COUNT; ++i) {
+                totals.counters[i] += thread.counters[i];
+            }
+            for (int i = 0; i < HISTOGRAM_COUNT; ++i) {
+                totals.histograms[i].merge(thread.histograms[i]);
+            }
+            ++totals.threads;
+        }
+
+        double per_second(const uint64_t value, const double seconds) noexcept {
+            return seconds > 0 ? static_cast<double>(value) / seconds : 0.0;
+        }
+
+        void write_histogram(std::ostream& out, const HistogramData& histogram) {
+            out << "{\"count\": " << histogram.count << ", \"min\": " << histogram.min << ", \"max\": " << histogram.max
+                << ", \"mean\": " << (histogram.count > 0 ? histogram.sum / static_cast<double>(histogram.count) : 0.0) << ", \"buckets\": [";
+            // empty buckets are omitted, \"max\" is exclusive
+            bool first = true;
+            for (int i = 0; i < HistogramData::BUCKETS; ++i) {
+                if (histogram.buckets[i] == 0) {
+                    continue;
+                }
+                out << (first ? "" : ", ") << "{\"min\": " << HistogramData::bucket_min(i) << ", \"max\": ";
+                if (i + 1 < HistogramData::BUCKETS) {
+                    out << HistogramData::bucket_min(i + 1);
+                } else {
+                    out << "null";
+                }
+                out << ", \"count\": " << histogram.buckets[i] << '}';
+                first = false;
+            }
+            out << "]}";
+        }
+
+        void write_json(std::ostream& out, const double wall_time) {
+            const Totals totals = collect();
+            const uint64_t features = totals.counter(Counter::features_in);
+            const uint64_t parts = totals.counter(Counter::parts_out);
+            out << std::fixed << std::setprecision(6)
+                << "{\n  \"wall_time_s\": " << wall_time << ",\n  \"threads\": " << totals.threads << ",\n"
+                << "  \"startup\": {\n"
+                << "    \"total_s\": " << startup.total << ",\n"
+                << "    \"register_drivers_s\": " << startup.register_drivers << ",\n"
+                << "    \"open_input_s\": " << startup.open_input << ",\n"
+                << "    \"drivers\": " << startup.drivers << ",\n"
+                << "    \"all_drivers\": " << (startup.all_drivers ? "true" : "false") << "\n  },\n";
+            for (int i = 0; i < COUNTER_COUNT; ++i) {
+                out << "  \"" << counter_name(static_cast<Counter>(i)) << "\": " << totals.counters[i] << ",\n";
+            }
+            out << "  \"parts_per_feature\": " << (features > 0 ? static_cast<double>(parts) / static_cast<double>(features) : 0.0) << ",\n"
+                << "  \"throughput\": {\n"
+                << "    \"features_per_s\": " << per_second(features, wall_time) << ",\n"
+                << "    \"vertices_per_s\": " << per_second(totals.counter(Counter::vertices), wall_time) << ",\n"
+                << "    \"parts_per_s\": " << per_second(parts, wall_time) << "\n  },\n"
+                << "  \"stages_s\": {\n";
+            // times are summed over all threads
+            for (int i = 0; i < STAGE_COUNT; ++i) {
+                out << "    \"" << stage_name(static_cast<Stage>(i)) << "\": " << static_cast<double>(totals.time_ns[i]) / 1e9
+                    << (i + 1 < STAGE_COUNT ? ",\n" : "\n");
+            }
+            out << "  },\n  \"memory_bytes\": {\n"
+                << "    \"peak_rss\": " << memory::peak_rss() << ",\n"
+                << "    \"queues_peak\": " << memory::queues.peak() << ",\n"
+                << "    \"sorter_peak\": " << memory::sorter.peak() << ",\n"
+                << "    \"gdal_cache\": " << memory::gdal_cache_used() << ",\n"
+                << "    \"limit\": " << memory::limit << "\n"
+                << "  },\n  \"histograms\": {\n";
+            for (int i = 0; i < HISTOGRAM_COUNT; ++i) {
+                out << "    \"" << histogram_name(static_cast<Histogram>(i)) << "\": ";
+                write_histogram(out, totals.histograms[i]);
+                out << (i + 1 < HISTOGRAM_COUNT ? ",\n" : "\n");
+            }
+            out << "  }\n}\n";
+        }
+
+    } // anonymous namespace
+
+    const char* stage_name(const Stage stage) noexcept {
+        switch (stage) {
+        case Stage::other:
+            return "other";
+        case Stage::read:
+            return "read";
+        case Stage::skip_ring:
+            return "skip_ring";
+        case Stage::split:
+            return "split";
+        case Stage::fields:
+            return "fields";
+        case Stage::write:
+            return "write";
+        case Stage::commit:
+            return "commit";
+        case Stage::sort:
+            return "sort";
+        case Stage::queue_wait:
+            return "queue_wait";
+        case Stage::idle:
+            return "idle";
+        case Stage::finalize:
+            return "finalize";
+        }
+        return "unknown";
+    }
+
+    const char* counter_name(const Counter counter) noexcept {
+        switch (counter) {
+        case Counter::features_in:
+            return "features_in";
+        case Counter::linestrings:
+            return "linestrings";
+        case Counter::vertices:
+            return "vertices";
+        case Counter::rings_skipped:
+            return "rings_skipped";
+        case Counter::parts_out:
+            return "parts_out";
+        }
+        return "unknown";
+    }
+
+    const char* histogram_name(const Histogram histogram) noexcept {
+        switch (histogram) {
+        case Histogram::part_length:
+            return "part_length";
+        case Histogram::vertices_per_part:
+            return "vertices_per_part";
+        case Histogram::parts_per_feature:
+            return "parts_per_feature";
+        case Histogram::dropped_ring_length:
+            return "dropped_ring_length";
+        }
+        return "unknown";
+    }
+
+    void HistogramData::merge(const HistogramData& other) noexcept {
+        if (other.count == 0) {
+            return;
+        }
+        for (int i = 0; i < BUCKETS; ++i) {
+            buckets[i] += other.buckets[i];
+        }
+        min = count == 0 ? other.min : std::min(min, other.min);
+        max = count == 0 ? other.max : std::max(max, other.max);
+        count += other.count;
+        sum += other.sum;
+    }
+
+    ThreadStats::ThreadStats() :
+        m_since(clock::now()),
+        time_ns(),
+        counters(),
+        histograms() {
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock {r.mutex};
+        r.threads.insert(this);
+    }
+
+    ThreadStats::~ThreadStats() {
+        switch_to(m_stage);
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock {r.mutex};
+        r.threads.erase(this);
+        add(*this, r.exited);
+    }
+
+    void enable() noexcept {
+        enabled = true;
+    }
+
+    ThreadStats& thread_stats() {
+        thread_local ThreadStats instance;
+        return instance;
+    }
+
+    Totals collect() {
+        // bring the time of the current stage of the calling thread up to date
+        thread_stats().switch_to(Stage::other);
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock {r.mutex};
+        Totals totals = r.exited;
+        for (const ThreadStats* thread : r.threads) {
+            add(*thread, totals);
+        }
+        return totals;
+    }
+
+    void write_report(const std::string& filename, const double wall_time) {
+        if (filename == "-") {
+            write_json(std::cerr, wall_time);
+            return;
+        }
+        std::ofstream out {filename};
+        write_json(out, wall_time);
+        if (!out) {
+            std::cerr << "ERROR: failed to write statistics to " << filename << '\n';
+            exit(1);
+        }
+    }
+
+} // namespace stats
@@ -0,0 +1,276 @@
+/*
+ *  © 2018 Geofabrik GmbH
+ *
+ *  This file is part of LinestringsSplitter.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef STATS_HPP_
+#define STATS_HPP_
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <string>
+
+/**
+ * Low-overhead instrumentation of the stages of a run (see --stats).
+ *
+ * Every thread has its own counters. A thread is always in exactly one stage; switching the
+ * stage charges the time since the last switch to the previous stage. Nested stages therefore
+ * yield exclusive times, e.g. the time spent in write_part() is not part of the split stage.
+ * The counters of a thread are merged into the totals when the thread exits.
+ *
+ * If statistics are disabled, switching stages and counting are no-ops apart from one branch.
+ */
+namespace stats {
+
+    enum class Stage : int {
+        /// everything not covered by another stage (opening files, setting up the output, …)
+        other = 0,
+        /// reading input features (GetNextFeature)
+        read,
+        /// checking whether a linestring has to be skipped
+        skip_ring,
+        /// walking the vertices of a linestring and cutting it into parts
+        split,
+        /// copying attributes into output features or records
+        fields,
+        /// building output geometries and writing them (CreateFeature, COPY, stream)
+        write,
+        /// committing transactions
+        commit,
+        /// adding parts to the external sorter and reading them back
+        sort,
+        /// waiting for space in the queue of a writer thread
+        queue_wait,
+        /// writer thread waiting for records
+        idle,
+        /// closing the output
+        finalize
+    };
+
+    constexpr int STAGE_COUNT = static_cast<int>(Stage::finalize) + 1;
+
+    enum class Counter : int {
+        features_in = 0,
+        linestrings,
+        vertices,
+        rings_skipped,
+        parts_out
+    };
+
+    constexpr int COUNTER_COUNT = static_cast<int>(Counter::parts_out) + 1;
+
+    enum class Histogram : int {
+        /// length of the output parts (in metres or units of the input SRS)
+        part_length = 0,
+        vertices_per_part,
+        parts_per_feature,
+        /// length of the rings dropped because they are shorter than --min-length
+        dropped_ring_length
+    };
+
+    constexpr int HISTOGRAM_COUNT = static_cast<int>(Histogram::dropped_ring_length) + 1;
+
+    /**
+     * Histogram with logarithmic buckets: bucket 0 counts values below 1, bucket i > 0 counts
+     * values in [2^(i-1), 2^i). The last bucket takes all larger values.
+     */
+    struct HistogramData {
+        static constexpr int BUCKETS = 48;
+
+        uint64_t buckets[BUCKETS];
+
+        uint64_t count;
+
+        double sum;
+
+        double min;
+
+        double max;
+
+        static double bucket_min(const int bucket) noexcept {
+            return bucket == 0 ? 0.0 : std::ldexp(1.0, bucket - 1);
+        }
+
+        void add(const double value) noexcept {
+            // std::ilogb() is not defined for these, e.g. lengths of linestrings with NaN coordinates
+            if (!std::isfinite(value)) {
+                return;
+            }
+            const int bucket = value < 1.0 ? 0 : std::min(std::ilogb(value) + 1, BUCKETS - 1);
+            ++buckets[bucket];
+            if (count == 0 || value < min) {
+                min = value;
+            }
+            if (count == 0 || value > max) {
+                max = value;
+            }
+            ++count;
+            sum += value;
+        }
+
+        void merge(const HistogramData& other) noexcept;
+    };
+
+    const char* stage_name(const Stage stage) noexcept;
+
+    const char* counter_name(const Counter counter) noexcept;
+
+    const char* histogram_name(const Histogram histogram) noexcept;
+
+    /**
+     * Counters of one thread.
+     */
+    class ThreadStats {
+        using clock = std::chrono::steady_clock;
+
+        Stage m_stage = Stage::other;
+
+        clock::time_point m_since;
+
+    public:
+        uint64_t time_ns[STAGE_COUNT];
+
+        uint64_t counters[COUNTER_COUNT];
+
+        HistogramData histograms[HISTOGRAM_COUNT];
+
+        ThreadStats();
+
+        ThreadStats(const ThreadStats&) = delete;
+
+        ThreadStats& operator=(const ThreadStats&) = delete;
+
+        /// Merges the counters into the totals.
+        ~ThreadStats();
+
+        /**
+         * Charge the time since the last switch to the current stage and enter another one.
+         *
+         * \returns previous stage
+         */
+        Stage switch_to(const Stage stage) noexcept {
+            const clock::time_point now = clock::now();
+            time_ns[static_cast<int>(m_stage)] += static_cast<uint64_t>(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(now - m_since).count());
+            m_since = now;
+            const Stage previous = m_stage;
+            m_stage = stage;
+            return previous;
+        }
+    };
+
+    /// True if statistics are collected, set by enable() before any work starts.
+    extern bool enabled;
+
+    void enable() noexcept;
+
+    /**
+     * Counters of the calling thread.
+     */
+    ThreadStats& thread_stats();
+
+    inline void count(const Counter counter, const uint64_t value = 1) {
+        if (enabled) {
+            thread_stats().counters[static_cast<int>(counter)] += value;
+        }
+    }
+
+    inline void add(const Histogram histogram, const double value) {
+        if (enabled) {
+            thread_stats().histograms[static_cast<int>(histogram)].add(value);
+        }
+    }
+
+    /**
+     * Switch the calling thread to a stage for the lifetime of this object.
+     */
+    class StageScope {
+        Stage m_previous = Stage::other;
+
+    public:
+        explicit StageScope(const Stage stage) {
+            if (enabled) {
+                m_previous = thread_stats().switch_to(stage);
+            }
+        }
+
+        StageScope(const StageScope&) = delete;
+
+        StageScope& operator=(const StageScope&) = delete;
+
+        ~StageScope() {
+            if (enabled) {
+                thread_stats().switch_to(m_previous);
+            }
+        }
+    };
+
+    /**
+     * Sum of the counters of all threads. Must only be called after all other threads
+     * have finished.
+     */
+    struct Totals {
+        uint64_t time_ns[STAGE_COUNT];
+
+        uint64_t counters[COUNTER_COUNT];
+
+        HistogramData histograms[HISTOGRAM_COUNT];
+
+        int threads;
+
+        uint64_t counter(const Counter c) const noexcept {
+            return counters[static_cast<int>(c)];
+        }
+    };
+
+    Totals collect();
+
+    /**
+     * Time from the start of the programme until the input is open.
+     */
+    struct Startup {
+        /// seconds spent registering GDAL drivers
+        double register_drivers = 0.0;
+
+        /// seconds spent opening the input dataset
+        double open_input = 0.0;
+
+        /// seconds from the start of the programme until the input is open
+        double total = 0.0;
+
+        /// number of registered drivers
+        int drivers = 0;
+
+        /// false if only the drivers of the input and output formats were registered
+        bool all_drivers = false;
+    };
+
+    extern Startup startup;
+
+    /**
+     * Write the statistics as JSON to the file (- for stderr).
+     *
+     * \param wall_time duration of the whole run in seconds
+     */
+    void write_report(const std::string& filename, const double wall_time);
+
+} // namespace stats
+
+#endif /* STATS_HPP_ */
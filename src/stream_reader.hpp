@@ -0,0 +1,291 @@
+/*
+ *  © 2018 Geofabrik GmbH
+ *
+ *  This file is part of LinestringsSplitter.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef STREAM_READER_HPP_
+#define STREAM_READER_HPP_
+
+/**
+ * Reader for the WKBStream output format of LinestringsSplitter.
+ *
+ * This header does not depend on GDAL and can be copied into other programmes.
+ *
+ * All numbers are stored in little endian byte order. A stream starts with a header:
+ *
+ *   - magic bytes "LSSTREAM"
+ *   - uint8 byte order (1 = little endian, like WKB)
+ *   - uint8 version of the format (1)
+ *   - uint8 grid cell flag (1 if every record contains a grid cell)
+ *   - uint8 reserved
+ *   - uint32 number of fields, followed by type (uint32, the value of OGRFieldType) and name
+ *     (uint32 length and bytes) of every field
+ *
+ * It is followed by records:
+ *
+ *   - uint32 size of the remainder of the record, 0 marks the end of the stream
+ *   - int64 FID of the input feature
+ *   - uint32 size of the geometry and the geometry as WKB (LineString)
+ *   - int32 column and row of the grid cell if the grid cell flag is set
+ *   - packed attributes: per field a state byte (0 = unset, 1 = null, 2 = set) followed by
+ *     the value if the field is set. Integers and reals are stored as 4/8 byte numbers, dates
+ *     and times as 12 byte structs (int16 year, uint8 month, day, hour, minute, time zone flag,
+ *     padding and float32 second), strings as uint32 length plus bytes plus a terminating null
+ *     byte, binary fields as uint32 length and bytes, lists as uint32 number of items and the
+ *     items.
+ *
+ * Records are written as soon as they are complete, i.e. a stream can be consumed while it is
+ * still being written (e.g. from a pipe or FIFO).
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+class StreamReader {
+public:
+    /// field types, the values are the ones of OGRFieldType
+    enum FieldType : uint32_t {
+        integer = 0,
+        integer_list = 1,
+        real = 2,
+        real_list = 3,
+        string = 4,
+        string_list = 5,
+        wide_string = 6,
+        wide_string_list = 7,
+        binary = 8,
+        date = 9,
+        time = 10,
+        date_time = 11,
+        integer64 = 12,
+        integer64_list = 13
+    };
+
+    enum class FieldState : unsigned char {
+        unset = 0,
+        null = 1,
+        set = 2
+    };
+
+    struct Field {
+        std::string name;
+
+        FieldType type;
+    };
+
+    /**
+     * Record read from the stream. All pointers point into the buffer of the reader and are
+     * valid until the next call of StreamReader::next().
+     */
+    struct Record {
+        int64_t fid;
+
+        const unsigned char* wkb;
+
+        uint32_t wkb_size;
+
+        int32_t cell_x;
+
+        int32_t cell_y;
+
+        /// packed attributes, use StreamReader::read_value() to decode them
+        const char* attributes;
+
+        const char* end;
+    };
+
+    /**
+     * Value of a field. data points to the value (not necessarily aligned), size is the size of
+     * the value in bytes, count is the number of items of lists.
+     */
+    struct Value {
+        FieldState state;
+
+        const char* data;
+
+        uint32_t size;
+
+        uint32_t count;
+    };
+
+private:
+    std::FILE* m_file;
+
+    std::vector<Field> m_fields;
+
+    bool m_has_cell = false;
+
+    std::vector<char> m_buffer;
+
+    void read_bytes(void* data, const size_t size) {
+        if (size > 0 && std::fread(data, size, 1, m_file) != 1) {
+            throw std::runtime_error{"unexpected end of stream"};
+        }
+    }
+
+    template <typename T>
+    T read_number() {
+        T value;
+        read_bytes(&value, sizeof(T));
+        return value;
+    }
+
+    template <typename T>
+    static T get(const char*& data) noexcept {
+        T value;
+        std::memcpy(&value, data, sizeof(T));
+        data += sizeof(T);
+        return value;
+    }
+
+    static uint32_t fixed_size(const FieldType type) noexcept {
+        switch (type) {
+        case integer:
+        case integer_list:
+            return 4;
+        case date:
+        case time:
+        case date_time:
+            return 12;
+        case binary:
+            return 1;
+        default:
+            return 8;
+        }
+    }
+
+    void read_header() {
+        char magic[8];
+        read_bytes(magic, sizeof(magic));
+        if (std::memcmp(magic, "LSSTREAM", sizeof(magic))) {
+            throw std::runtime_error{"not a LinestringsSplitter stream"};
+        }
+        const uint32_t one = 1;
+        const bool little_endian = *reinterpret_cast<const unsigned char*>(&one) == 1;
+        if (read_number<unsigned char>() != 1 || !little_endian) {
+            throw std::runtime_error{"only little endian streams on little endian machines are supported"};
+        }
+        if (read_number<unsigned char>() != 1) {
+            throw std::runtime_error{"unsupported version of the stream format"};
+        }
+        m_has_cell = read_number<unsigned char>() == 1;
+        read_number<unsigned char>();
+        const uint32_t field_count = read_number<uint32_t>();
+        for (uint32_t i = 0; i < field_count; ++i) {
+            Field field;
+            field.type = static_cast<FieldType>(read_number<uint32_t>());
+            field.name.resize(read_number<uint32_t>());
+            read_bytes(&field.name[0], field.name.size());
+            m_fields.push_back(std::move(field));
+        }
+    }
+
+public:
+    /**
+     * Open a stream and read its header. The file is not closed by the reader.
+     */
+    explicit StreamReader(std::FILE* file) :
+        m_file(file),
+        m_fields(),
+        m_buffer() {
+        read_header();
+    }
+
+    const std::vector<Field>& fields() const noexcept {
+        return m_fields;
+    }
+
+    bool has_cell() const noexcept {
+        return m_has_cell;
+    }
+
+    /**
+     * Read the next record. Returns false at the end of the stream.
+     */
+    bool next(Record& record) {
+        const uint32_t size = read_number<uint32_t>();
+        if (size == 0) {
+            return false;
+        }
+        m_buffer.resize(size);
+        read_bytes(m_buffer.data(), size);
+        const char* data = m_buffer.data();
+        record.fid = get<int64_t>(data);
+        record.wkb_size = get<uint32_t>(data);
+        record.wkb = reinterpret_cast<const unsigned char*>(data);
+        data += record.wkb_size;
+        record.cell_x = m_has_cell ? get<int32_t>(data) : 0;
+        record.cell_y = m_has_cell ? get<int32_t>(data) : 0;
+        record.attributes = data;
+        record.end = m_buffer.data() + size;
+        return true;
+    }
+
+    /**
+     * Decode the value of a field of a record.
+     *
+     * \param data position of the field in the packed attributes, is moved to the next field
+     * \param type type of the field
+     */
+    static Value read_value(const char*& data, const FieldType type) noexcept {
+        Value value;
+        value.state = get<FieldState>(data);
+        value.data = nullptr;
+        value.size = 0;
+        value.count = 1;
+        if (value.state != FieldState::set) {
+            return value;
+        }
+        switch (type) {
+        case string:
+        case wide_string:
+            value.size = get<uint32_t>(data);
+            value.data = data;
+            data += value.size + 1;
+            return value;
+        case string_list:
+        case wide_string_list:
+            // items are strings (uint32 length, bytes, null byte)
+            value.count = get<uint32_t>(data);
+            value.data = data;
+            for (uint32_t i = 0; i < value.count; ++i) {
+                data += get<uint32_t>(data) + 1;
+            }
+            value.size = static_cast<uint32_t>(data - value.data);
+            return value;
+        case binary:
+        case integer_list:
+        case real_list:
+        case integer64_list:
+            value.count = get<uint32_t>(data);
+            break;
+        default:
+            break;
+        }
+        value.size = value.count * fixed_size(type);
+        value.data = data;
+        data += value.size;
+        return value;
+    }
+};
+
+#endif /* STREAM_READER_HPP_ */
@@ -0,0 +1,122 @@
+/*
+ *  © 2018 Geofabrik GmbH
+ *
+ *  This file is part of LinestringsSplitter.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "stream_writer.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#include "attributes.hpp"
+
+StreamWriter::StreamWriter(const std::string& filename, OGRLayer* input_layer, Options& options) :
+    Writer(input_layer, options),
+    m_filename(filename),
+    m_file(nullptr),
+    m_record() {
+    const uint32_t one = 1;
+    if (*reinterpret_cast<const unsigned char*>(&one) != 1) {
+        std::cerr << "ERROR: " << WKB_STREAM_FORMAT << " is only supported on little endian machines.\n";
+        exit(1);
+    }
+    if (m_filename == "-") {
+        m_file = stdout;
+    } else {
+        m_file = std::fopen(m_filename.c_str(), "wb");
+        if (!m_file) {
+            std::cerr << "ERROR: failed to open " << m_filename << ": " << std::strerror(errno) << '\n';
+            exit(1);
+        }
+    }
+    std::setvbuf(m_file, nullptr, _IOFBF, BUFFER_SIZE);
+    write_header();
+}
+
+StreamWriter::~StreamWriter() {
+    stop_thread();
+    if (m_file && m_file != stdout) {
+        std::fclose(m_file);
+    }
+}
+
+void StreamWriter::write_bytes(const void* data, const size_t size) {
+    if (std::fwrite(data, size, 1, m_file) != 1) {
+        std::cerr << "ERROR: writing to " << m_filename << " failed: " << std::strerror(errno) << '\n';
+        exit(1);
+    }
+}
+
+void StreamWriter::write_header() {
+    std::string header {"LSSTREAM"};
+    // byte order, version, grid cell flag, reserved
+    attributes::append<unsigned char>(header, 1);
+    attributes::append<unsigned char>(header, 1);
+    attributes::append<unsigned char>(header, m_options.grid_size > 0 ? 1 : 0);
+    attributes::append<unsigned char>(header, 0);
+    attributes::append<uint32_t>(header, static_cast<uint32_t>(m_input_field_count));
+    for (int i = 0; i < m_input_field_count; ++i) {
+        OGRFieldDefn* field_def = m_input_defn->GetFieldDefn(i);
+        const char* name = field_def->GetNameRef();
+        attributes::append<uint32_t>(header, static_cast<uint32_t>(field_def->GetType()));
+        attributes::append<uint32_t>(header, static_cast<uint32_t>(std::strlen(name)));
+        header.append(name);
+    }
+    write_bytes(header.data(), header.size());
+}
+
+void StreamWriter::write_part(const double* x_coords, const double* y_coords, const int count, OGRFeature* feature,
+        const GridCell* cell) {
+    m_record.clear();
+    // The size of the record is filled in when the record is complete.
+    attributes::append<uint32_t>(m_record, 0);
+    attributes::append<int64_t>(m_record, feature->GetFID());
+    attributes::append<uint32_t>(m_record, static_cast<uint32_t>(9 + 16 * count));
+    // WKB: byte order, geometry type, number of points, coordinates
+    attributes::append<unsigned char>(m_record, 1);
+    attributes::append<uint32_t>(m_record, static_cast<uint32_t>(wkbLineString));
+    attributes::append<uint32_t>(m_record, static_cast<uint32_t>(count));
+    for (int i = 0; i < count; ++i) {
+        attributes::append<double>(m_record, x_coords[i]);
+        attributes::append<double>(m_record, y_coords[i]);
+    }
+    if (m_options.grid_size > 0) {
+        attributes::append<int32_t>(m_record, cell ? cell->x : 0);
+        attributes::append<int32_t>(m_record, cell ? cell->y : 0);
+    }
+    attributes::pack(feature, m_record);
+    const uint32_t size = static_cast<uint32_t>(m_record.size() - sizeof(uint32_t));
+    std::memcpy(&m_record[0], &size, sizeof(size));
+    write_bytes(m_record.data(), m_record.size());
+}
+
+void StreamWriter::finalize() {
+    stop_thread();
+    // end of stream marker
+    const uint32_t end = 0;
+    write_bytes(&end, sizeof(end));
+    if (std::fflush(m_file) != 0) {
+        std::cerr << "ERROR: writing to " << m_filename << " failed: " << std::strerror(errno) << '\n';
+        exit(1);
+    }
+    if (m_file != stdout) {
+        std::fclose(m_file);
+    }
+    m_file = nullptr;
+}
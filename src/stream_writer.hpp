@@ -0,0 +1,64 @@
+/*
+ *  © 2018 Geofabrik GmbH
+ *
+ *  This file is part of LinestringsSplitter.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef STREAM_WRITER_HPP_
+#define STREAM_WRITER_HPP_
+
+#include <cstdio>
+#include <string>
+
+#include "writer.hpp"
+
+/**
+ * Writer for the WKBStream format, a compact binary stream of WKB geometries and packed
+ * attributes which can be written to stdout or a FIFO. The format is described in
+ * stream_reader.hpp.
+ */
+class StreamWriter : public Writer {
+private:
+    /// size of the stdio buffer of the output
+    static constexpr size_t BUFFER_SIZE = 1024 * 1024;
+
+    std::string m_filename;
+
+    std::FILE* m_file;
+
+    /// buffer for the record currently being built
+    std::string m_record;
+
+    void write_bytes(const void* data, const size_t size);
+
+    void write_header();
+
+public:
+    /**
+     * \param filename output file, "-" for stdout
+     */
+    StreamWriter(const std::string& filename, OGRLayer* input_layer, Options& options);
+
+    ~StreamWriter();
+
+    void write_part(const double* x_coords, const double* y_coords, const int count, OGRFeature* feature,
+            const GridCell* cell) override;
+
+    void finalize() override;
+};
+
+#endif /* STREAM_WRITER_HPP_ */
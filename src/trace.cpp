@@ -0,0 +1,167 @@
+/*
+ *  © 2018 Geofabrik GmbH
+ *
+ *  This file is part of LinestringsSplitter.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "trace.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace trace {
+
+    bool enabled = false;
+
+    namespace {
+
+        using clock = std::chrono::steady_clock;
+
+        struct Event {
+            const char* name;
+            const char* arg_name;
+            int64_t arg;
+            const char* arg2_name;
+            int64_t arg2;
+            clock::time_point start;
+            clock::time_point end;
+        };
+
+        /**
+         * Events of one thread. Buffers are kept after their thread has exited.
+         */
+        struct ThreadBuffer {
+            int tid;
+
+            const char* name = nullptr;
+
+            std::vector<Event> events;
+
+            /// total number of events recorded, the ring buffer holds the last min(count, capacity) ones
+            size_t count = 0;
+        };
+
+        struct Registry {
+            std::mutex mutex;
+
+            size_t capacity = 0;
+
+            clock::time_point origin;
+
+            std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+        };
+
+        Registry& registry() {
+            static Registry instance;
+            return instance;
+        }
+
+        ThreadBuffer& thread_buffer() {
+            thread_local ThreadBuffer* buffer = nullptr;
+            if (!buffer) {
+                Registry& r = registry();
+                std::lock_guard<std::mutex> lock {r.mutex};
+                r.buffers.emplace_back(new ThreadBuffer{});
+                buffer = r.buffers.back().get();
+                buffer->tid = static_cast<int>(r.buffers.size());
+                buffer->events.reserve(r.capacity);
+            }
+            return *buffer;
+        }
+
+        /// microseconds since the start of the trace
+        double timestamp(const clock::time_point time) {
+            return std::chrono::duration<double, std::micro>(time - registry().origin).count();
+        }
+
+        void write_event(std::ostream& out, const ThreadBuffer& buffer, const Event& event) {
+            out << ",\n{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer.tid
+                << ",\"ts\":" << timestamp(event.start) << ",\"dur\":"
+                << std::chrono::duration<double, std::micro>(event.end - event.start).count();
+            if (event.arg_name) {
+                out << ",\"args\":{\"" << event.arg_name << "\":" << event.arg;
+                if (event.arg2_name) {
+                    out << ",\"" << event.arg2_name << "\":" << event.arg2;
+                }
+                out << '}';
+            }
+            out << '}';
+        }
+
+    } // anonymous namespace
+
+    void enable(const size_t capacity) {
+        Registry& r = registry();
+        r.capacity = capacity;
+        r.origin = clock::now();
+        enabled = true;
+    }
+
+    void set_thread_name(const char* name) {
+        if (enabled) {
+            thread_buffer().name = name;
+        }
+    }
+
+    void record(const char* name, const clock::time_point start, const clock::time_point end,
+            const char* arg_name, const int64_t arg, const char* arg2_name, const int64_t arg2) {
+        ThreadBuffer& buffer = thread_buffer();
+        const Event event {name, arg_name, arg, arg2_name, arg2, start, end};
+        if (buffer.events.size() < buffer.events.capacity()) {
+            buffer.events.push_back(event);
+        } else {
+            buffer.events[buffer.count % buffer.events.size()] = event;
+        }
+        ++buffer.count;
+    }
+
+    void write(const std::string& filename) {
+        std::ofstream out {filename};
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock {r.mutex};
+        size_t dropped = 0;
+        out << std::fixed;
+        out.precision(3);
+        out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+            << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"linestringssplitter\"}}";
+        for (const std::unique_ptr<ThreadBuffer>& buffer : r.buffers) {
+            if (buffer->name) {
+                out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->tid
+                    << ",\"args\":{\"name\":\"" << buffer->name << "\"}}";
+            }
+            // oldest event first
+            const size_t size = buffer->events.size();
+            const size_t first = buffer->count > size ? buffer->count % size : 0;
+            for (size_t i = 0; i < size; ++i) {
+                write_event(out, *buffer, buffer->events[(first + i) % size]);
+            }
+            dropped += buffer->count - size;
+        }
+        out << "\n]}\n";
+        if (!out) {
+            std::cerr << "ERROR: failed to write trace to " << filename << '\n';
+            exit(1);
+        }
+        if (dropped > 0) {
+            std::cerr << "Trace: " << dropped << " old events were overwritten, the trace covers the end of the run only.\n";
+        }
+    }
+
+} // namespace trace
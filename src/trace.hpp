@@ -0,0 +1,110 @@
+/*
+ *  © 2018 Geofabrik GmbH
+ *
+ *  This file is part of LinestringsSplitter.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef TRACE_HPP_
+#define TRACE_HPP_
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/**
+ * Timeline of the pipeline in the Chrome trace event format, which can be opened with Perfetto
+ * or chrome://tracing (see --trace).
+ *
+ * Every thread records complete events into its own ring buffer, no locks are taken while
+ * recording. If a buffer is full, the oldest events are overwritten. If tracing is disabled,
+ * a Span costs one branch.
+ */
+namespace trace {
+
+    /// True if events are recorded, set by enable() before any work starts.
+    extern bool enabled;
+
+    /**
+     * Enable tracing.
+     *
+     * \param capacity maximum number of events kept per thread
+     */
+    void enable(const size_t capacity);
+
+    /**
+     * Name the calling thread in the trace. The name must be a string literal or live until write() is called.
+     */
+    void set_thread_name(const char* name);
+
+    /**
+     * Add an event to the ring buffer of the calling thread.
+     *
+     * Names of events and arguments must be string literals (only the pointers are stored).
+     */
+    void record(const char* name, const std::chrono::steady_clock::time_point start,
+            const std::chrono::steady_clock::time_point end, const char* arg_name = nullptr, const int64_t arg = 0,
+            const char* arg2_name = nullptr, const int64_t arg2 = 0);
+
+    /**
+     * Record an event lasting from the construction to the destruction of this object.
+     */
+    class Span {
+        const char* m_name;
+
+        const char* m_arg_name = nullptr;
+
+        int64_t m_arg = 0;
+
+        std::chrono::steady_clock::time_point m_start;
+
+    public:
+        explicit Span(const char* name) :
+            m_name(name),
+            m_start() {
+            if (enabled) {
+                m_start = std::chrono::steady_clock::now();
+            }
+        }
+
+        Span(const Span&) = delete;
+
+        Span& operator=(const Span&) = delete;
+
+        /**
+         * Attach a numeric argument (e.g. the number of records) to the event.
+         */
+        void set_arg(const char* name, const int64_t value) noexcept {
+            m_arg_name = name;
+            m_arg = value;
+        }
+
+        ~Span() {
+            if (enabled) {
+                record(m_name, m_start, std::chrono::steady_clock::now(), m_arg_name, m_arg);
+            }
+        }
+    };
+
+    /**
+     * Write the events of all threads to a JSON file. Must only be called after all other
+     * threads have finished.
+     */
+    void write(const std::string& filename);
+
+} // namespace trace
+
+#endif /* TRACE_HPP_ */
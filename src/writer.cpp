@@ -0,0 +1,142 @@
+/*
+ *  © 2018 Geofabrik GmbH
+ *
+ *  This file is part of LinestringsSplitter.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "writer.hpp"
+
+#include "attributes.hpp"
+#include "memory.hpp"
+#include "part_record.hpp"
+#include "stats.hpp"
+#include "trace.hpp"
+
+Writer::Writer(OGRLayer* input_layer, Options& options) :
+    m_options(options),
+    m_input_defn(input_layer->GetLayerDefn()->Clone()),
+    m_input_field_count(m_input_defn->GetFieldCount()),
+    m_x_coords(),
+    m_y_coords(),
+    m_thread(),
+    m_mutex(),
+    m_queue_changed(),
+    m_queue(),
+    m_max_queue_bytes(memory::limit / 4 / static_cast<size_t>(options.shards)) {
+    m_input_defn->Reference();
+}
+
+Writer::~Writer() {
+    stop_thread();
+    m_input_defn->Release();
+}
+
+void Writer::write_linestring(OGRLineString* linestring, OGRFeature* feature) {
+    const int count = linestring->getNumPoints();
+    m_x_coords.resize(static_cast<size_t>(count));
+    m_y_coords.resize(static_cast<size_t>(count));
+    for (int i = 0; i < count; ++i) {
+        m_x_coords[static_cast<size_t>(i)] = linestring->getX(i);
+        m_y_coords[static_cast<size_t>(i)] = linestring->getY(i);
+    }
+    write_part(m_x_coords.data(), m_y_coords.data(), count, feature, nullptr);
+}
+
+void Writer::write_record(const std::string& record) {
+    const part_record::View view = part_record::decode(record);
+    part_record::read_coordinates(view, m_x_coords, m_y_coords);
+    OGRFeature* feature = OGRFeature::CreateFeature(m_input_defn);
+    {
+        stats::StageScope stage {stats::Stage::fields};
+        attributes::unpack(view.attributes, m_input_field_count, feature);
+    }
+    feature->SetFID(view.fid);
+    write_part(m_x_coords.data(), m_y_coords.data(), static_cast<int>(view.count), feature,
+            view.has_cell ? &view.cell : nullptr);
+    OGRFeature::DestroyFeature(feature);
+}
+
+void Writer::start_thread() {
+    m_thread = std::thread{&Writer::run_thread, this};
+}
+
+bool Writer::queue_full() const noexcept {
+    if (m_queue.size() >= MAX_QUEUE_SIZE) {
+        return true;
+    }
+    // the memory limit never blocks an empty queue
+    return m_max_queue_bytes > 0 && m_queue_bytes >= m_max_queue_bytes;
+}
+
+void Writer::push(std::string&& record) {
+    stats::StageScope stage {stats::Stage::queue_wait};
+    std::unique_lock<std::mutex> lock {m_mutex};
+    if (queue_full()) {
+        trace::Span span {"queue full"};
+        m_queue_changed.wait(lock, [this]() {
+            return !queue_full();
+        });
+    }
+    m_queue_bytes += record.size();
+    memory::queues.add(record.size());
+    m_queue.push_back(std::move(record));
+    lock.unlock();
+    m_queue_changed.notify_all();
+}
+
+void Writer::run_thread() {
+    trace::set_thread_name("writer");
+    std::deque<std::string> records;
+    size_t records_bytes = 0;
+    while (true) {
+        {
+            stats::StageScope stage {stats::Stage::idle};
+            std::unique_lock<std::mutex> lock {m_mutex};
+            m_queue_changed.wait(lock, [this]() {
+                return !m_queue.empty() || m_input_done;
+            });
+            if (m_queue.empty()) {
+                return;
+            }
+            // take all waiting records at once to keep the lock short
+            records.swap(m_queue);
+            records_bytes = m_queue_bytes;
+            m_queue_bytes = 0;
+        }
+        m_queue_changed.notify_all();
+        stats::StageScope stage {stats::Stage::write};
+        trace::Span span {"flush"};
+        span.set_arg("records", static_cast<int64_t>(records.size()));
+        for (const std::string& record : records) {
+            write_record(record);
+        }
+        memory::queues.sub(records_bytes);
+        records.clear();
+    }
+}
+
+void Writer::stop_thread() {
+    if (!m_thread.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock {m_mutex};
+        m_input_done = true;
+    }
+    m_queue_changed.notify_all();
+    m_thread.join();
+}
@@ -0,0 +1,145 @@
+/*
+ *  © 2018 Geofabrik GmbH
+ *
+ *  This file is part of LinestringsSplitter.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 3
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef WRITER_HPP_
+#define WRITER_HPP_
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gdal/ogr_api.h>
+#include <gdal/ogrsf_frmts.h>
+
+#include "options.hpp"
+
+/**
+ * Base class of the output backends.
+ *
+ * Parts can either be written directly by the thread owning the writer or be handed over as
+ * serialized part records (see part_record.hpp) to a background thread (see start_thread()).
+ * Derived classes have to call stop_thread() in their destructor and in finalize() before
+ * they release any resources the background thread uses.
+ */
+class Writer {
+protected:
+    Options& m_options;
+
+    /// copy of the schema of the input layer, owned by this writer
+    OGRFeatureDefn* m_input_defn;
+
+    int m_input_field_count;
+
+    /// coordinate buffers used when writing part records
+    std::vector<double> m_x_coords;
+
+    std::vector<double> m_y_coords;
+
+    /**
+     * Let the background thread write the remaining records and wait for it.
+     */
+    void stop_thread();
+
+private:
+    /// maximum number of records waiting in the queue of the background thread
+    static constexpr size_t MAX_QUEUE_SIZE = 4096;
+
+    std::thread m_thread;
+
+    std::mutex m_mutex;
+
+    std::condition_variable m_queue_changed;
+
+    std::deque<std::string> m_queue;
+
+    bool m_input_done = false;
+
+    /// size of the records in the queue
+    size_t m_queue_bytes = 0;
+
+    /// maximum size of the records in the queue (derived from --memory-limit), 0 for no limit
+    size_t m_max_queue_bytes;
+
+    bool queue_full() const noexcept;
+
+    void run_thread();
+
+public:
+    Writer(OGRLayer* input_layer, Options& options);
+
+    Writer() = delete;
+
+    Writer(const Writer&) = delete;
+
+    Writer& operator=(const Writer&) = delete;
+
+    virtual ~Writer();
+
+    /**
+     * Write a part with the attributes of an input feature.
+     *
+     * \param feature input feature (having the schema of the input layer)
+     * \param cell grid cell of the part, null if not running in grid mode
+     */
+    virtual void write_part(const double* x_coords, const double* y_coords, const int count, OGRFeature* feature,
+            const GridCell* cell) = 0;
+
+    /**
+     * Write a linestring of an input feature which does not have to be split as a part.
+     *
+     * The default implementation copies the coordinates and calls write_part().
+     */
+    virtual void write_linestring(OGRLineString* linestring, OGRFeature* feature);
+
+    /**
+     * Write a part serialized by part_record::encode().
+     *
+     * The default implementation restores the attributes of the input feature and calls write_part().
+     */
+    virtual void write_record(const std::string& record);
+
+    /**
+     * Check if the writer reads the attributes of the features passed to write_part(). If no
+     * writer does, they do not have to be read from the input layer.
+     */
+    virtual bool needs_attributes() const noexcept {
+        return true;
+    }
+
+    /**
+     * Write all records passed to push() in a background thread.
+     */
+    void start_thread();
+
+    /**
+     * Add a record to the queue of the background thread. Blocks if the queue is full.
+     */
+    void push(std::string&& record);
+
+    /**
+     * Write everything which is still buffered and close the output.
+     */
+    virtual void finalize() = 0;
+};
+
+#endif /* WRITER_HPP_ */